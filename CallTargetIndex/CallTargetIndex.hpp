@@ -0,0 +1,257 @@
+//===---- Module-wide Index of Call Targets and Callee Memory Effects -----===//
+//
+//
+//===----------------------------------------------------------------------===//
+// Resolving what a call site can call means walking the called value through
+// phis, loads, geps, arguments and the returns of other calls, and falling
+// back on every address-taken function of the right type for calls through
+// globals. The index does that walk once for every call site of a module and
+// keeps the results, together with what memory each callee may touch
+//===----------------------------------------------------------------------===//
+
+#ifndef _CALLTARGETINDEXHEADER_
+#define _CALLTARGETINDEXHEADER_
+
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/DenseMap.h"
+
+using namespace llvm;
+using namespace std;
+
+class CallTargetIndex {
+public:
+  //Bits describing what memory a callee may access
+  enum MemoryEffects {
+    NoMemoryEffects = 0,
+    ReadsMemory = 1,
+    WritesMemory = 2
+  };
+
+  //What a single call site may call. Inline assembly is not a function, so
+  //it is recorded separately
+  struct CallTargets {
+    CallTargets() : callsAsm(false), callsAtomicAsm(false) {}
+    SmallPtrSet<Function*,1> funs;
+    bool callsAsm;
+    //True if any called assembly contains a "lock" prefix
+    bool callsAtomicAsm;
+  };
+
+  CallTargetIndex() {}
+
+  //Resolves every call site of M, dropping any earlier index
+  void buildIndex(Module &M) {
+    clear();
+    for (Function &fun : M.getFunctionList()) {
+      memoryEffects[&fun] = computeMemoryEffects(&fun);
+      if (fun.hasAddressTaken())
+        addressTakenOfType[fun.getFunctionType()].push_back(&fun);
+      for (inst_iterator it = inst_begin(&fun); it != inst_end(&fun); ++it)
+        if (auto ret = dyn_cast<ReturnInst>(&*it))
+          if (Value *returnval = ret->getReturnValue())
+            returnValues[&fun].push_back(returnval);
+    }
+    vector<Instruction*> callSites;
+    for (Function &fun : M.getFunctionList())
+      for (inst_iterator it = inst_begin(&fun); it != inst_end(&fun); ++it)
+        if (isCallSite(&*it))
+          callSites.push_back(&*it);
+    set<Instruction*> resolving;
+    bool cutCycle = false;
+    for (Instruction *inst : callSites)
+      resolveMemoized(inst,resolving,cutCycle);
+    //Calls resolved while a cycle was cut may miss what the cut call
+    //resolves into later. Their targets only grow, so they are walked
+    //again until nothing changes
+    while (cutCycle) {
+      cutCycle = false;
+      for (Instruction *inst : callSites) {
+        CallTargets targets;
+        walkCalledValue(inst,targets,[&](Instruction *call) -> CallTargets {
+            return callTargets[call];
+          });
+        CallTargets &known = callTargets[inst];
+        if (targets.funs.size() != known.funs.size() || targets.callsAsm != known.callsAsm ||
+            targets.callsAtomicAsm != known.callsAtomicAsm) {
+          known = targets;
+          cutCycle = true;
+        }
+      }
+    }
+  }
+
+  //Returns what inst may call. Call sites created after the index was built
+  //are resolved on the spot but not remembered, so lookups never write to
+  //the index and can be made from several threads
+  CallTargets getCallTargets(Instruction *inst) const {
+    auto found = callTargets.find(inst);
+    if (found != callTargets.end())
+      return found->second;
+    CallTargets toReturn;
+    if (isCallSite(inst)) {
+      set<Instruction*> resolving;
+      resolveUncached(inst,toReturn,resolving);
+    }
+    return toReturn;
+  }
+
+  //Convenience call
+  SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) const {
+    return getCallTargets(inst).funs;
+  }
+
+  unsigned getMemoryEffects(Function *fun) const {
+    auto found = memoryEffects.find(fun);
+    if (found != memoryEffects.end())
+      return found->second;
+    return computeMemoryEffects(fun);
+  }
+
+  void clear() {
+    callTargets.clear();
+    memoryEffects.clear();
+    addressTakenOfType.clear();
+    returnValues.clear();
+  }
+
+private:
+  map<Instruction*,CallTargets> callTargets;
+  DenseMap<Function*,unsigned> memoryEffects;
+  map<FunctionType*,vector<Function*> > addressTakenOfType;
+  map<Function*,vector<Value*> > returnValues;
+
+  //Utility: Checks whether an instruction could be a callsite
+  static bool isCallSite(Instruction *inst) {
+    CallSite call(inst);
+    return call.isCall() || call.isInvoke();
+  }
+
+  //Utility: Returns the proper type of a pointer type
+  static Type *getTypeOfPointerType(Type *ptr) {
+    while (PointerType *p = dyn_cast<PointerType>(ptr))
+      ptr = p->getElementType();
+    return ptr;
+  }
+
+  static unsigned computeMemoryEffects(Function *fun) {
+    if (fun->doesNotAccessMemory())
+      return NoMemoryEffects;
+    if (fun->onlyReadsMemory())
+      return ReadsMemory;
+    return ReadsMemory | WritesMemory;
+  }
+
+  //Resolves inst into the index. Calls whose result is being resolved
+  //further up are cut off with what is known of them so far, and cutCycle
+  //is set so the results are completed afterwards
+  const CallTargets &resolveMemoized(Instruction *inst, set<Instruction*> &resolving, bool &cutCycle) {
+    auto found = callTargets.find(inst);
+    if (found != callTargets.end() && resolving.count(inst) == 0)
+      return found->second;
+    CallTargets &targets = callTargets[inst];
+    if (resolving.count(inst) != 0) {
+      cutCycle = true;
+      return targets;
+    }
+    resolving.insert(inst);
+    walkCalledValue(inst,targets,[&](Instruction *call) -> CallTargets {
+        return resolveMemoized(call,resolving,cutCycle);
+      });
+    resolving.erase(inst);
+    return targets;
+  }
+
+  void resolveUncached(Instruction *inst, CallTargets &targets, set<Instruction*> &resolving) const {
+    resolving.insert(inst);
+    walkCalledValue(inst,targets,[&](Instruction *call) -> CallTargets {
+        auto found = callTargets.find(call);
+        if (found != callTargets.end())
+          return found->second;
+        CallTargets nested;
+        if (resolving.count(call) == 0)
+          resolveUncached(call,nested,resolving);
+        return nested;
+      });
+    resolving.erase(inst);
+  }
+
+  //Walks the value called by inst back to the functions it could be
+  //resolved into. targetsOf gives the targets of calls whose returned value
+  //is called
+  template <typename TargetsOfT>
+  void walkCalledValue(Instruction *inst, CallTargets &targets, TargetsOfT targetsOf) const {
+    SmallPtrSet<Value*,8> alreadyVisited;
+    deque<Value*> calledValues;
+    calledValues.push_back(CallSite(inst).getCalledValue());
+    while (!calledValues.empty()) {
+      Value *nextValue = calledValues.front();
+      calledValues.pop_front();
+      nextValue = nextValue->stripInBoundsConstantOffsets();
+      if (alreadyVisited.count(nextValue) != 0)
+        continue;
+      alreadyVisited.insert(nextValue);
+      //Try to resolve the value into a function
+      if (auto fun = dyn_cast<Function>(nextValue))
+        targets.funs.insert(fun);
+      //Since we are dealing with functions, only a few
+      //instructions should be possible
+      else if (auto phi = dyn_cast<PHINode>(nextValue))
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i)
+          calledValues.push_back(phi->getIncomingValue(i));
+      else if (isa<Instruction>(nextValue) && isCallSite(cast<Instruction>(nextValue))) {
+        //We get the return from a function, toss all values that could be
+        //returned from that function onto the queue
+        for (Function *fun : targetsOf(cast<Instruction>(nextValue)).funs) {
+          auto returns = returnValues.find(fun);
+          if (returns != returnValues.end())
+            calledValues.insert(calledValues.end(),returns->second.begin(),returns->second.end());
+        }
+      }
+      else if (auto inlineasm = dyn_cast<InlineAsm>(nextValue)) {
+        targets.callsAsm = true;
+        if (inlineasm->getAsmString().find("lock") != string::npos)
+          targets.callsAtomicAsm = true;
+      }
+      //Here we pick apart data structures
+      else if (auto gep = dyn_cast<GetElementPtrInst>(nextValue))
+        //Any remaining gep must, by definition, have a dynamic index
+        //So we just resolve the value that is gepped from
+        calledValues.push_back(gep->getPointerOperand());
+      else if (auto load = dyn_cast<LoadInst>(nextValue))
+        calledValues.push_back(load->getPointerOperand());
+      else if (auto arg = dyn_cast<Argument>(nextValue)) {
+        //Track values from the callsites
+        for (User *user : arg->getParent()->users()) {
+          if (isa<Instruction>(user) && isCallSite(cast<Instruction>(user))) {
+            CallSite callsite(user);
+            calledValues.push_back(callsite.getArgOperand(arg->getArgNo()));
+          }
+        }
+      }
+      else if (auto glob = dyn_cast<GlobalVariable>(nextValue)) {
+        //at this point we can basically give up, any function
+        //that has its adress taken can be used here
+        FunctionType *type = dyn_cast<FunctionType>(getTypeOfPointerType(glob->getType()));
+        auto funs = addressTakenOfType.find(type);
+        if (funs != addressTakenOfType.end())
+          targets.funs.insert(funs->second.begin(),funs->second.end());
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,61 @@
+//===------- Call target index of a module, kept by the pass manager ------===//
+//
+//
+//===----------------------------------------------------------------------===//
+// The index is an analysis of its own, so every pass of a pipeline shares
+// it. It is rebuilt whenever a pass that changes the module has invalidated
+// it, so call sites that were removed or added are never looked up in a
+// stale index
+//===----------------------------------------------------------------------===//
+
+#ifndef _CALLTARGETINDEXPASS_
+#define _CALLTARGETINDEXPASS_
+
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include "CallTargetIndex.hpp"
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+    struct CallTargetIndexPass : public ModulePass {
+        static char ID;
+        CallTargetIndexPass() : ModulePass(ID) {}
+
+        virtual void getAnalysisUsage(AnalysisUsage &AU) const{
+            AU.setPreservesAll();
+        }
+
+        virtual bool runOnModule(Module &M) {
+            index.buildIndex(M);
+            return false;
+        }
+
+        virtual void releaseMemory() {
+            index.clear();
+        }
+
+        CallTargetIndex &getIndex() {
+            return index;
+        }
+
+    private:
+        CallTargetIndex index;
+    };
+}
+
+char CallTargetIndexPass::ID = 0;
+static RegisterPass<CallTargetIndexPass> T("call-target-index",
+                                           "Resolves what every call site of the module may call",
+                                           false,
+                                           true);
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* indent-tabs-mode: nil */
+/* c-basic-offset: 4 */
+/* End: */
@@ -0,0 +1,88 @@
+//===------- Per-function alias results shared by the analysis passes ------===//
+//
+//
+//===----------------------------------------------------------------------===//
+// Building the alias results of a function sets up BasicAA with its
+// assumption cache and library info. The results are kept in an immutable
+// pass, so every pass of a pipeline that asks for a function gets the same
+// results, and they are freed together with the pass manager
+//===----------------------------------------------------------------------===//
+
+#ifndef _AARESULTSCACHE_
+#define _AARESULTSCACHE_
+
+#include <map>
+#include <mutex>
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/BasicAliasAnalysis.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+    struct AAResultsCache : public ImmutablePass {
+        static char ID;
+        AAResultsCache() : ImmutablePass(ID) {}
+
+        ~AAResultsCache() {
+            releaseResults();
+        }
+
+        //The results for fun, built the first time they are asked for.
+        //builder has to require AssumptionCacheTracker and
+        //TargetLibraryInfoWrapperPass
+        AAResults *getResults(Function *fun, Pass &builder) {
+            lock_guard<mutex> lock(resultsMutex);
+            FunctionResults &results = resultsOfFun[fun];
+            if (!results.combined) {
+                results.basic = new BasicAAResult(createLegacyPMBasicAAResult(builder,*fun));
+                results.combined = new AAResults(createLegacyPMAAResults(builder,*fun,*results.basic));
+            }
+            return results.combined;
+        }
+
+        //Queries on the results have to hold this lock when several threads
+        //may ask. The results of all functions share module-wide analyses,
+        //such as the scalar evolution behind SCEV-AA, that cache as they answer
+        mutex &getQueryLock() {
+            return queryMutex;
+        }
+
+        void releaseResults() {
+            lock_guard<mutex> lock(resultsMutex);
+            for (auto &results : resultsOfFun) {
+                //The combined results refer to the basic ones
+                delete results.second.combined;
+                delete results.second.basic;
+            }
+            resultsOfFun.clear();
+        }
+
+    private:
+        struct FunctionResults {
+            BasicAAResult *basic=NULL;
+            AAResults *combined=NULL;
+        };
+
+        map<Function*,FunctionResults> resultsOfFun;
+        mutex resultsMutex;
+        mutex queryMutex;
+    };
+}
+
+char AAResultsCache::ID = 0;
+static RegisterPass<AAResultsCache> U("aa-results-cache",
+                                      "Keeps the alias results of each function for the passes that share them",
+                                      false,
+                                      true);
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* indent-tabs-mode: nil */
+/* c-basic-offset: 4 */
+/* End: */
@@ -10,11 +10,20 @@
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Module.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
 
 #include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 #include "UseChainAliasing.cpp"
+#include "AAResultsCache.cpp"
+#include "../ThreadSharing/ThreadSharing.cpp"
 // #include "WPA/FlowSensitive.h"
 // #include "MemoryModel/PointerAnalysis.h"
 #include "../SVF-master/include/WPA/WPAPass.h"
@@ -41,25 +50,77 @@
 // //Debug should more accurately print exactly what is happening
 // #define DEBUG_PRINT(X) DEBUG_WITH_TYPE("debug",PRINT_DEBUG << X)
 
+#define DEBUG_TYPE "AliasCombiner"
+STATISTIC(NumConflictQueries, "Number of conflict queries between instructions");
+STATISTIC(NumConflictCacheHits, "Number of conflict queries answered from the instruction pair cache");
+STATISTIC(NumPointerQueries, "Number of alias queries between pointers");
+STATISTIC(NumPointerCacheHits, "Number of alias queries answered from the pointer pair cache");
+STATISTIC(NumCheapTierQueries, "Number of pointer pairs given to the cheap alias tier");
+STATISTIC(NumCheapTierNoAlias, "Number of pointer pairs proven not to alias by the cheap alias tier");
+STATISTIC(NumLLVMTierQueries, "Number of pointer pairs given to the LLVM alias tier");
+STATISTIC(NumLLVMTierNoAlias, "Number of pointer pairs proven not to alias by the LLVM alias tier");
+STATISTIC(NumSVFTierQueries, "Number of pointer pairs given to the SVF alias tier");
+STATISTIC(NumSVFTierNoAlias, "Number of pointer pairs proven not to alias by the SVF alias tier");
+STATISTIC(NumUseChainTierQueries, "Number of pointer pairs given to the use chain alias tier");
+STATISTIC(NumUseChainTierNoAlias, "Number of pointer pairs proven not to alias by the use chain alias tier");
+#undef DEBUG_TYPE
+
+//The alias analyses a pointer pair is given to, a NoAlias from any of them
+//is final so later tiers are skipped
+enum AliasTier {
+    CheapAliasTier,
+    LLVMAliasTier,
+    SVFAliasTier,
+    UseChainAliasTier,
+    NumAliasTiers
+};
+
+static cl::list<AliasTier> aliasTierOrder("aaorder",cl::desc("The order to ask the alias analyses in, tiers left out are not asked (default: cheap,llvm,svf,usechain)"),
+                                          cl::CommaSeparated,
+                                          cl::values(clEnumValN(CheapAliasTier,"cheap","Identical values and distinct globals"),
+                                                     clEnumValN(LLVMAliasTier,"llvm","The LLVM alias analyses"),
+                                                     clEnumValN(SVFAliasTier,"svf","The SVF pointer analysis, if it was run"),
+                                                     clEnumValN(UseChainAliasTier,"usechain","Use chain aliasing, if it is enabled"),
+                                                     clEnumValEnd));
+
+static cl::opt<bool> timeAliasTiers("aatiertime",cl::desc("Time each alias tier and print the times when done"));
+
 //Functions that should never be considered for tracking
 set<StringRef> noAnalyzeFunctions = {"begin_NDRF","end_NDRF","begin_XDRF","end_XDRF"};
 
 class AliasCombiner {
   
 public:
-    AliasCombiner(Module *mod, Pass *callingPass) {
-        AliasCombiner(mod,false,callingPass);
-    }
+    AliasCombiner(Module *mod, Pass *callingPass) :
+        AliasCombiner(mod,false,callingPass) {}
 
-    AliasCombiner(Module *mod, bool useUseChain, Pass *callingPass) {
-        AliasCombiner(mod, useUseChain, callingPass, MustAlias);
-    }
+    AliasCombiner(Module *mod, bool useUseChain, Pass *callingPass) :
+        AliasCombiner(mod, useUseChain, callingPass, MustAlias) {}
 
     AliasCombiner(Module *mod, bool useUseChain, Pass *callingPass, AliasResult aliasLevel) {
         module=mod;
         useUseChainAliasing=useUseChain;
         willAliasLevel=aliasLevel;
         this->callingPass=callingPass;
+        callTargets=&callingPass->getAnalysis<CallTargetIndexPass>().getIndex();
+        threadSharing=&callingPass->getAnalysis<ThreadSharing>();
+        aaResultsCache=&callingPass->getAnalysis<AAResultsCache>();
+        useChain=useUseChain ? new UseChainAliasing(mod,callingPass) : NULL;
+        if (aliasTierOrder.empty())
+            tierOrder = {CheapAliasTier, LLVMAliasTier, SVFAliasTier, UseChainAliasTier};
+        else
+            tierOrder.assign(aliasTierOrder.begin(),aliasTierOrder.end());
+        for (unsigned tier = 0; tier < NumAliasTiers; ++tier)
+            tierNanoseconds[tier] = 0;
+    }
+
+    ~AliasCombiner() {
+        if (timeAliasTiers) {
+            const char *tierNames[NumAliasTiers] = {"Cheap tier", "LLVM tier", "SVF tier", "Use chain tier"};
+            for (AliasTier tier : tierOrder)
+                PRINT << tierNames[tier] << ": " << tierNanoseconds[tier]/1e9 << "s\n";
+        }
+        delete useChain;
     }
 
 
@@ -177,279 +238,514 @@ public:
     //For each argument we need to prove it does not alias, and if we can then we return false
     bool MustConflict(Instruction *ptr1, Instruction *ptr2) {
         VERBOSE_PRINT("Examining whether accesses " << *ptr1 << " and " << *ptr2 << " are aliasing under any analysis\n");
+        NumConflictQueries++;
+        //The question is symmetric, so both orders share a cache entry
+        pair<Instruction*,Instruction*> key = ptr1 < ptr2 ? make_pair(ptr1,ptr2) : make_pair(ptr2,ptr1);
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            auto found = conflictCache.find(key);
+            if (found != conflictCache.end()) {
+                NumConflictCacheHits++;
+                VERBOSE_PRINT("Resolved dynamically to " << (found->second ? "true\n" : "false\n"));
+                return found->second;
+            }
+        }
         bool toReturn=false;
-        SmallPtrSet<Value*,4> ptr1args=getArguments(ptr1);
-        SmallPtrSet<Value*,4> ptr2args=getArguments(ptr2);
+        //Pointers no other thread can reach never conflict
+        SmallPtrSet<Value*,4> ptr1args=getSharedArguments(ptr1);
+        SmallPtrSet<Value*,4> ptr2args=getSharedArguments(ptr2);
         for (Value *P1a : ptr1args) {
             if(isa<PointerType>(P1a->getType())) {
                 for (Value *P2a : ptr2args) {
                     if (isa<PointerType>(P2a->getType())) {
                         LIGHT_PRINT("Determining whether " << *P1a << " and " << *P2a << " may conservatively conflict\n");
-
-                        if (!(canBeShared(P1a) && canBeShared(P2a))) {
-                            LIGHT_PRINT("Determined at least one of them cannot be shared between threads\n");
-                            continue;
-                        }
-
-                        pair<Value*,Value*> comparable=getComparableValues(P1a,P2a);
-                        if (!(comparable.first && comparable.second)) {
-                            LIGHT_PRINT("Failed to find comparable values\n");
-                            continue;
-                        }
-
-                        Function * parent = NULL;
-                        if (Instruction * inst = dyn_cast<Instruction>(comparable.first)) {
-                            parent=inst->getParent()->getParent() ? inst->getParent()->getParent() : parent;
-                        }
-                        if (Argument * inst = dyn_cast<Argument>(comparable.first)) {
-                            parent=inst->getParent() ? inst->getParent() : parent;
-                        }
-                        if (Instruction * inst = dyn_cast<Instruction>(comparable.second)) {
-                            parent=inst->getParent()->getParent() ? inst->getParent()->getParent() : parent;
-                        }
-                        if (Argument * inst = dyn_cast<Argument>(comparable.second)) {
-                            parent=inst->getParent() ? inst->getParent() : parent;
-                        }
-
-                        LIGHT_PRINT("Comparing " << *(comparable.first) << " and " << *(comparable.second) << "\n");
-                        LIGHT_PRINT("Which have types: " << typeid(*comparable.first).name() << " and " << typeid(*comparable.second).name() << "\n");
-
-                        //Some shortcutting is desirable here
-                        if (isa<GlobalVariable>(comparable.first) && isa<GlobalVariable>(comparable.second)) {
-                            //Might want to do more advanced stuff later
-                            if (comparable.first == comparable.second) {
-                                LIGHT_PRINT("Determined to alias by virtue of being the same global");
-                                return true;
-                            }
-                        }
-                        
-                        //This is for the weird case where no comparable value is within a function.
-                        if (!parent) {
-                            LIGHT_PRINT("Neither comparable value is within a function\n");
-                            continue;
-                        }
-                        
-                        bool aliased=false;
-
-                        LIGHT_PRINT("Testing with LLVM AAs\n");
-                        AliasResult res = getAAResultsForFun(parent)->alias(comparable.first,comparable.second);
-                        LIGHT_PRINT("Got " << res << "\n");
-                        
-                        if (WPAPass *svf = callingPass->getAnalysisIfAvailable<WPAPass>()) {
-                            LIGHT_PRINT("Testing with SVF AAs\n");
-                            AliasResult svfres = svf->alias(comparable.first,comparable.second);
-                            if (svfres == NoAlias)
-                                res = NoAlias;
-                            LIGHT_PRINT("Got " << svfres << "\n");
-                        }
-                        
-                        //If we get "mayalias" then use the usechainaliasing instead
-                        if (useUseChainAliasing) {
-                            LIGHT_PRINT("Testing with usechainaliasing\n");
-                            usechain_wm=module;
-                            AliasResult usechainresult = pointerAlias(P1a,P2a,callingPass);
-                            LIGHT_PRINT("Got " << usechainresult << "\n");
-                            if (res == MayAlias || usechainresult == NoAlias) {
-                                res=usechainresult;
-                            }                                
-                        }
-                        
-                        switch (res) {
-                        case NoAlias:
-                            LIGHT_PRINT("Got NoAlias\n");
-                            if (willAliasLevel < MayAlias) {
-                                aliased=true;
-                            }
-                            break;
-                        case MayAlias:
-                            LIGHT_PRINT("Got MayAlias\n");
-                            if (willAliasLevel < PartialAlias) {
-                                aliased=true;
-                            }
-                            break;
-                        case PartialAlias:
-                            LIGHT_PRINT("Got PartialAlias\n");
-                            if (willAliasLevel < MustAlias) {
-                                aliased=true;
-                            }
-                            break;
-                        case MustAlias:
-                            LIGHT_PRINT("Got MustAlias\n");
-                        default:
-                            aliased=true;
+                        const PointerPairResults &results = getPointerPairResults(P1a,P2a);
+                        if (results.verdict == PointerPairResults::SameGlobal) {
+                            LIGHT_PRINT("Determined to alias by virtue of being the same global");
+                            toReturn=true;
                             break;
                         }
-                        if (aliased) {
+                        if (results.verdict != PointerPairResults::Queried)
+                            continue;
+                        if (exceedsAliasLevel(results.combined())) {
                             VERBOSE_PRINT("Determined to alias\n");
-                            return true;
+                            toReturn=true;
+                            break;
                         }
                         else
                             LIGHT_PRINT("Did not find any proof of aliasing\n");
                     }
                 }
+                if (toReturn)
+                    break;
             }
         }
-        VERBOSE_PRINT("Did not find proof of aliasing\n");
-        return toReturn;
+        if (!toReturn)
+            VERBOSE_PRINT("Did not find proof of aliasing\n");
+        lock_guard<mutex> lock(cacheMutex);
+        return conflictCache[key]=toReturn;
+    }
+
+    //Whether tier is one of the tiers -aaorder asks
+    bool asksTier(AliasTier tier) const {
+        return find(tierOrder.begin(),tierOrder.end(),tier) != tierOrder.end();
+    }
+
+    //Whether the tiers that are asked prove accesses to distinct objects
+    //apart, as getAccessedObjects assumes. The use chain tier does so for
+    //distinct bottom level values, BasicAA in the LLVM tier for distinct
+    //identified objects
+    bool canSeparateAccesses() const {
+        return willAliasLevel >= MayAlias &&
+            ((useUseChainAliasing && asksTier(UseChainAliasTier)) || asksTier(LLVMAliasTier));
+    }
+
+    //Whether pointers based on distinct globals are never found to alias.
+    //The cheap tier proves so directly, BasicAA in the LLVM tier as well
+    bool separatesDistinctGlobals() const {
+        return willAliasLevel >= MayAlias &&
+            (asksTier(CheapAliasTier) || asksTier(LLVMAliasTier));
+    }
+
+    //Asks SVF about the pointers of inst against those of each of others
+    //in one batch, so the SVF tier finds the answers when MustConflict
+    //gets to the pairs. Nothing is done unless SVF is asked and was run
+    void prefetchSVFResults(Instruction *inst, const vector<Instruction*> &others) {
+        WPAPass *svf = callingPass->getAnalysisIfAvailable<WPAPass>();
+        if (!svf || !asksTier(SVFAliasTier))
+            return;
+        vector<pair<Value*,Value*> > pending;
+        set<pair<Value*,Value*> > queued;
+        SmallPtrSet<Value*,4> instArgs = getSharedArguments(inst);
+        for (Instruction *other : others) {
+            SmallPtrSet<Value*,4> otherArgs = getSharedArguments(other);
+            for (Value *P1a : instArgs) {
+                if (!isa<PointerType>(P1a->getType()))
+                    continue;
+                for (Value *P2a : otherArgs) {
+                    if (!isa<PointerType>(P2a->getType()))
+                        continue;
+                    pair<Value*,Value*> comparable = getComparableValues(P1a,P2a);
+                    if (!(comparable.first && comparable.second))
+                        continue;
+                    if (comparable.second < comparable.first)
+                        std::swap(comparable.first,comparable.second);
+                    if (queued.insert(comparable).second)
+                        pending.push_back(comparable);
+                }
+            }
+        }
+        lock_guard<mutex> lock(svfMutex);
+        pending.erase(remove_if(pending.begin(),pending.end(),
+                                [this](const pair<Value*,Value*> &comparable) {
+                                    return svfResultCache.count(comparable) != 0;
+                                }),pending.end());
+        if (pending.empty())
+            return;
+        vector<AliasResult> answers;
+        svf->aliasBatch(vector<WPAPass::ValuePair>(pending.begin(),pending.end()),answers);
+        for (unsigned i = 0; i < pending.size(); ++i)
+            svfResultCache[pending[i]] = answers[i];
+    }
+
+    //The abstract objects the shared pointers of inst may refer to. Two
+    //accesses that have no object in common never conflict. A NULL object
+    //stands for memory that could not be bounded, such an access may
+    //conflict with any other. When no tier that is asked can tell objects
+    //apart, every access is unbounded
+    const SmallPtrSet<Value*,4> &getAccessedObjects(Instruction *inst) {
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            auto found = accessedObjectsDynamic.find(inst);
+            if (found != accessedObjectsDynamic.end())
+                return found->second;
+        }
+        SmallPtrSet<Value*,4> objects;
+        if (!canSeparateAccesses()) {
+            objects.insert(NULL);
+        } else {
+            for (Value *arg : getSharedArguments(inst)) {
+                if (useUseChainAliasing && asksTier(UseChainAliasTier)) {
+                    //The use chain analysis answers NoAlias for pointers without
+                    //a common bottom level value, and that answer is final
+                    lock_guard<mutex> lock(useChainMutex);
+                    for (auto &group : useChain->getBottomLevelValues(arg))
+                        if (group.first)
+                            objects.insert(group.first);
+                } else {
+                    //Distinct identified objects are never found to alias
+                    SmallVector<Value*,4> underlying;
+                    GetUnderlyingObjects(arg,underlying,module->getDataLayout());
+                    for (Value *object : underlying)
+                        objects.insert(isIdentifiedObject(object) ? object : NULL);
+                }
+                //Pointers lifted to the same global always conflict
+                for (const vector<ContextValue> &level : getComparableRoots(arg))
+                    for (const ContextValue &root : level)
+                        if (isa<GlobalVariable>(root.first))
+                            objects.insert(root.first);
+            }
+        }
+        lock_guard<mutex> lock(cacheMutex);
+        return accessedObjectsDynamic.insert(make_pair(inst,objects)).first->second;
     }
 
 private:
 
     Module *module;
     Pass *callingPass;
+    //Shared index of what each call site may call
+    CallTargetIndex *callTargets;
+    //Which pointers can refer to memory several threads reach
+    ThreadSharing *threadSharing;
+    //The alias results of each function, shared with other passes
+    AAResultsCache *aaResultsCache;
+    //Only set up if useUseChainAliasing
+    UseChainAliasing *useChain;
+
+    //The order the tiers are asked in, and the time spent in each. Queries
+    //run on several threads at once, so the times of all threads are added
+    //up rather than kept in LLVM timers, which are not thread safe
+    vector<AliasTier> tierOrder;
+    atomic<uint64_t> tierNanoseconds[NumAliasTiers];
+
+    //The raw answers of the alias analyses for a pair of pointers. They do
+    //not depend on willAliasLevel, which is applied when they are used
+    struct PointerPairResults {
+        enum Verdict {
+            //No values in a common context were found
+            NotComparable,
+            //The comparable values are the same global
+            SameGlobal,
+            //Neither comparable value is within a function
+            NoParent,
+            //The analyses were asked, their answers are below
+            Queried
+        };
+        Verdict verdict=NotComparable;
+        AliasResult llvmResult=MayAlias;
+        AliasResult svfResult=MayAlias;
+        AliasResult useChainResult=MayAlias;
+        //The cheap tier answers in place of LLVM when it can
+        bool queriedLLVM=false;
+        bool queriedSVF=false;
+        bool queriedUseChain=false;
+
+        //The answer of the analyses together. A NoAlias from any of them
+        //decides it
+        AliasResult combined() const {
+            AliasResult res = llvmResult;
+            if (queriedSVF && svfResult == NoAlias)
+                res = NoAlias;
+            //If we get "mayalias" then use the usechainaliasing instead
+            if (queriedUseChain && (res == MayAlias || useChainResult == NoAlias))
+                res = useChainResult;
+            return res;
+        }
+    };
+
+    //Guards the caches below. Entries are computed outside it and never
+    //change once inserted, so the backends can be asked by several threads
+    mutex cacheMutex;
+    //The SVF and use chain analyses are asked by one thread at a time, the
+    //LLVM results of each function are locked in the AAResultsCache
+    mutex svfMutex;
+    mutex useChainMutex;
+
+    //Caches keyed on unordered pairs
+    map<pair<Instruction*,Instruction*>,bool> conflictCache;
+    //Guarded by svfMutex instead
+    map<pair<Value*,Value*>,AliasResult> svfResultCache;
+    map<pair<Value*,Value*>,PointerPairResults> pointerPairCache;
+    map<Instruction*,SmallPtrSet<Value*,4> > accessedObjectsDynamic;
+
+    //Whether res is strong enough an answer to count as aliasing
+    bool exceedsAliasLevel(AliasResult res) {
+        switch (res) {
+        case NoAlias:
+            LIGHT_PRINT("Got NoAlias\n");
+            return willAliasLevel < MayAlias;
+        case MayAlias:
+            LIGHT_PRINT("Got MayAlias\n");
+            return willAliasLevel < PartialAlias;
+        case PartialAlias:
+            LIGHT_PRINT("Got PartialAlias\n");
+            return willAliasLevel < MustAlias;
+        case MustAlias:
+            LIGHT_PRINT("Got MustAlias\n");
+        default:
+            return true;
+        }
+    }
 
-    map<Function*,AAResults*> AAResultMap;
+    const PointerPairResults &getPointerPairResults(Value *P1a, Value *P2a) {
+        NumPointerQueries++;
+        if (P2a < P1a)
+            std::swap(P1a,P2a);
+        pair<Value*,Value*> key = make_pair(P1a,P2a);
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            auto found = pointerPairCache.find(key);
+            if (found != pointerPairCache.end()) {
+                NumPointerCacheHits++;
+                return found->second;
+            }
+        }
+        PointerPairResults results;
+        queryPointerPair(P1a,P2a,results);
+        //Entries are never overwritten, so references to them stay valid
+        lock_guard<mutex> lock(cacheMutex);
+        return pointerPairCache.insert(make_pair(key,results)).first->second;
+    }
 
-    map<pair<Instruction*,Instruction*>,bool> shortcutConservative;
-    map<pair<Instruction*,Instruction*>,bool> shortcutOptimistic;
+    void queryPointerPair(Value *P1a, Value *P2a, PointerPairResults &results) {
+        pair<Value*,Value*> comparable=getComparableValues(P1a,P2a);
+        if (!(comparable.first && comparable.second)) {
+            LIGHT_PRINT("Failed to find comparable values\n");
+            results.verdict=PointerPairResults::NotComparable;
+            return;
+        }
 
-    AAResults * getAAResultsForFun(Function* parent) {
-        if (AAResultMap.count(parent) != 0) {
-            return AAResultMap[parent];
+        Function * parent = NULL;
+        if (Instruction * inst = dyn_cast<Instruction>(comparable.first)) {
+            parent=inst->getParent()->getParent() ? inst->getParent()->getParent() : parent;
+        }
+        if (Argument * inst = dyn_cast<Argument>(comparable.first)) {
+            parent=inst->getParent() ? inst->getParent() : parent;
+        }
+        if (Instruction * inst = dyn_cast<Instruction>(comparable.second)) {
+            parent=inst->getParent()->getParent() ? inst->getParent()->getParent() : parent;
+        }
+        if (Argument * inst = dyn_cast<Argument>(comparable.second)) {
+            parent=inst->getParent() ? inst->getParent() : parent;
         }
-        BasicAAResult * newbase = new BasicAAResult(createLegacyPMBasicAAResult(*callingPass,*parent));
-        AAResults *newaares = new AAResults(createLegacyPMAAResults(*callingPass,*parent,*newbase));
-        return AAResultMap[parent]=newaares;
-    }
-                                     
 
-    bool useUseChainAliasing;
+        LIGHT_PRINT("Comparing " << *(comparable.first) << " and " << *(comparable.second) << "\n");
+        LIGHT_PRINT("Which have types: " << typeid(*comparable.first).name() << " and " << typeid(*comparable.second).name() << "\n");
 
-    AliasResult willAliasLevel=MustAlias;
+        //Some shortcutting is desirable here
+        if (isa<GlobalVariable>(comparable.first) && isa<GlobalVariable>(comparable.second)) {
+            //Might want to do more advanced stuff later
+            if (comparable.first == comparable.second) {
+                results.verdict=PointerPairResults::SameGlobal;
+                return;
+            }
+        }
 
-    pair<Value*,Value*> getComparableValues(Value *val1, Value* val2) {
-        bool foundGlobalForVal1=false;
-        bool foundGlobalForVal2=false;
-        
-        SmallPtrSet<Value*,4> compareTowards1;
-        SmallPtrSet<Value*,4> compareTowards2;
-        SmallPtrSet<Value*,4> expandNext1;
-        SmallPtrSet<Value*,4> expandNext2;
-        expandNext1.insert(val1);
-        expandNext2.insert(val2);
-        while (expandNext1.size() != 0 || expandNext2.size() != 0) {
-            DEBUG_PRINT("Expanding next, sizes are: " << expandNext1.size() << " x " << expandNext2.size() << " (" << compareTowards1.size() << ", " << compareTowards2.size() << ")\n");
-            DEBUG_PRINT("Sets are:\n");
-            DEBUG_PRINT("EN1:\n");
-            for (Value * val : expandNext1)
-                DEBUG_PRINT(*val << "\n");
-            DEBUG_PRINT("EN2:\n");
-            for (Value * val : expandNext2)
-                DEBUG_PRINT(*val << "\n");
-            DEBUG_PRINT("CT1:\n");
-            for (Value * val : compareTowards1)
-                DEBUG_PRINT(*val << "\n");
-            DEBUG_PRINT("CT2:\n");
-            for (Value * val : compareTowards2)
-                DEBUG_PRINT(*val << "\n");
-            for (Value* val1_e : expandNext1) {
-                Function *parent1=NULL;
-                if (Instruction *val1_i = dyn_cast<Instruction>(val1_e))
-                    parent1=val1_i->getParent()->getParent();
-                if (Argument *val1_a = dyn_cast<Argument>(val1_e))
-                    parent1=val1_a->getParent();
-                for (Value* val2_c : compareTowards2) {
-                    if (isa<GlobalValue>(val1_e) || isa<GlobalValue>(val2_c))
-                        if (!(isa<GlobalValue>(val1_e) && isa<GlobalValue>(val2_c)))
-                            return make_pair(val1_e,val2_c);
-                    Function *parent2=NULL;
-                    if (Instruction *val2_i = dyn_cast<Instruction>(val2_c))
-                        parent2=val2_i->getParent()->getParent();
-                    if (Argument *val2_a = dyn_cast<Argument>(val2_c))
-                        parent2=val2_a->getParent();
-                    if (parent1==parent2)
-                        return make_pair(val1_e,val2_c);
-                }
-                for (Value* val2_e : expandNext2) {
-                    if (isa<GlobalValue>(val1_e) || isa<GlobalValue>(val2_e))
-                        if (!(isa<GlobalValue>(val1_e) && isa<GlobalValue>(val2_e)))
-                            return make_pair(val1_e,val2_e);
-                    Function *parent2=NULL;
-                    if (Instruction *val2_i = dyn_cast<Instruction>(val2_e))
-                        parent2=val2_i->getParent()->getParent();
-                    if (Argument *val2_a = dyn_cast<Argument>(val2_e))
-                        parent2=val2_a->getParent();
-                    if (parent1==parent2)
-                        return make_pair(val1_e,val2_e);
+        //This is for the weird case where no comparable value is within a function.
+        if (!parent) {
+            LIGHT_PRINT("Neither comparable value is within a function\n");
+            results.verdict=PointerPairResults::NoParent;
+            return;
+        }
+
+        results.verdict=PointerPairResults::Queried;
+        for (AliasTier tier : tierOrder) {
+            chrono::steady_clock::time_point started;
+            if (timeAliasTiers)
+                started = chrono::steady_clock::now();
+            bool provenNoAlias = queryTier(tier,P1a,P2a,comparable,parent,results);
+            if (timeAliasTiers)
+                tierNanoseconds[tier] += chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now()-started).count();
+            if (provenNoAlias) {
+                LIGHT_PRINT("Skipping the remaining tiers\n");
+                break;
+            }
+        }
+    }
+
+    //Asks one tier about the pair, returns true if it proved NoAlias
+    bool queryTier(AliasTier tier, Value *P1a, Value *P2a, pair<Value*,Value*> comparable,
+                   Function *parent, PointerPairResults &results) {
+        switch (tier) {
+        case CheapAliasTier:
+            NumCheapTierQueries++;
+            if (comparable.first == comparable.second) {
+                LIGHT_PRINT("Identical values\n");
+                results.llvmResult = MustAlias;
+                results.queriedLLVM = true;
+            } else if (isa<GlobalVariable>(comparable.first) && isa<GlobalVariable>(comparable.second)) {
+                LIGHT_PRINT("Distinct globals\n");
+                results.llvmResult = NoAlias;
+                results.queriedLLVM = true;
+                NumCheapTierNoAlias++;
+                return true;
+            }
+            return false;
+        case LLVMAliasTier:
+            if (results.queriedLLVM)
+                return false;
+            NumLLVMTierQueries++;
+            LIGHT_PRINT("Testing with LLVM AAs\n");
+            results.llvmResult = queryAAResultsForFun(parent,comparable.first,comparable.second);
+            results.queriedLLVM = true;
+            LIGHT_PRINT("Got " << results.llvmResult << "\n");
+            if (results.llvmResult != NoAlias)
+                return false;
+            NumLLVMTierNoAlias++;
+            return true;
+        case SVFAliasTier:
+            if (WPAPass *svf = callingPass->getAnalysisIfAvailable<WPAPass>()) {
+                NumSVFTierQueries++;
+                LIGHT_PRINT("Testing with SVF AAs\n");
+                lock_guard<mutex> lock(svfMutex);
+                results.svfResult = getSVFResult(svf,comparable);
+                results.queriedSVF = true;
+                LIGHT_PRINT("Got " << results.svfResult << "\n");
+                if (results.svfResult == NoAlias) {
+                    NumSVFTierNoAlias++;
+                    return true;
                 }
             }
-      
-            for (Value* val2_e : expandNext2) {
-                Function *parent2=NULL;
-                if (Instruction *val2_i = dyn_cast<Instruction>(val2_e))
-                    parent2=val2_i->getParent()->getParent();
-                if (Argument *val2_a = dyn_cast<Argument>(val2_e))
-                    parent2=val2_a->getParent();
-                for (Value* val1_c : compareTowards1) {
-                    if (isa<GlobalValue>(val1_c) || isa<GlobalValue>(val2_e))
-                        if (!(isa<GlobalValue>(val1_c) && isa<GlobalValue>(val2_e)))
-                            return make_pair(val1_c,val2_e);
-                    Function *parent1=NULL;
-                    if (Instruction *val1_i = dyn_cast<Instruction>(val1_c))
-                        parent2=val1_i->getParent()->getParent();
-                    if (Argument *val1_a = dyn_cast<Argument>(val1_c))
-                        parent2=val1_a->getParent();
-                    if (parent1==parent2)
-                        return make_pair(val1_c,val2_e);
+            return false;
+        case UseChainAliasTier:
+            if (useUseChainAliasing) {
+                NumUseChainTierQueries++;
+                LIGHT_PRINT("Testing with usechainaliasing\n");
+                lock_guard<mutex> lock(useChainMutex);
+                results.useChainResult = useChain->pointerAlias(P1a,P2a);
+                results.queriedUseChain = true;
+                LIGHT_PRINT("Got " << results.useChainResult << "\n");
+                if (results.useChainResult == NoAlias) {
+                    NumUseChainTierNoAlias++;
+                    return true;
                 }
-            }	
-    
-            for (Value* val1_e : expandNext1) {
-                compareTowards1.insert(val1_e);
             }
-            for (Value* val2_e : expandNext2) {
-                compareTowards2.insert(val2_e);
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    AAResults * getAAResultsForFun(Function* parent) {
+        return aaResultsCache->getResults(parent,*callingPass);
+    }
+
+    AliasResult queryAAResultsForFun(Function *parent, Value *ptr1, Value *ptr2) {
+        AAResults *results = getAAResultsForFun(parent);
+        lock_guard<mutex> lock(aaResultsCache->getQueryLock());
+        return results->alias(ptr1,ptr2);
+    }
+                                     
+
+    bool useUseChainAliasing;
+
+    AliasResult willAliasLevel=MustAlias;
+
+    //A value a pointer was lifted to, with the function it is in (NULL if it
+    //is not in a function)
+    typedef pair<Value*,Function*> ContextValue;
+
+    static Function *getParentFunction(Value *val) {
+        if (Instruction *inst = dyn_cast<Instruction>(val))
+            return inst->getParent()->getParent();
+        if (Argument *arg = dyn_cast<Argument>(val))
+            return arg->getParent();
+        return NULL;
+    }
+
+    //Two values can be compared if they are in the same function, or if
+    //exactly one of them is a global
+    static bool isComparable(const ContextValue &val1, const ContextValue &val2) {
+        if (isa<GlobalValue>(val1.first) != isa<GlobalValue>(val2.first))
+            return true;
+        return val1.second == val2.second;
+    }
+
+    //The SVF answer for a pair of comparable values. Pairs not asked in a
+    //batch before are asked as a batch of one. Called with svfMutex held
+    AliasResult getSVFResult(WPAPass *svf, pair<Value*,Value*> comparable) {
+        if (comparable.second < comparable.first)
+            std::swap(comparable.first,comparable.second);
+        auto found = svfResultCache.find(comparable);
+        if (found != svfResultCache.end())
+            return found->second;
+        vector<AliasResult> answers;
+        svf->aliasBatch(vector<WPAPass::ValuePair>(1,comparable),answers);
+        return svfResultCache[comparable] = answers.front();
+    }
+
+    //For each pointer, the values it is lifted to out of its function
+    //through arguments, callers and globals. Level n holds the values first
+    //found after n expansions
+    map<Value*,vector<vector<ContextValue> > > comparableRootsDynamic;
+
+    const vector<vector<ContextValue> > &getComparableRoots(Value *val) {
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            auto found = comparableRootsDynamic.find(val);
+            if (found != comparableRootsDynamic.end())
+                return found->second;
+        }
+        vector<vector<ContextValue> > levels;
+        bool foundGlobal=false;
+        SmallPtrSet<Value*,8> alreadyFound;
+        SmallPtrSet<Value*,4> expandNext;
+        expandNext.insert(val);
+        while (expandNext.size() != 0) {
+            levels.push_back(vector<ContextValue>());
+            for (Value *val_e : expandNext) {
+                levels.back().push_back(make_pair(val_e,getParentFunction(val_e)));
+                alreadyFound.insert(val_e);
             }
-      
-            //At this point, none of the previous values have been in the same function. So we must expand them
-            SmallPtrSet<Value*,4> expandNext1_new;
-            for (Value * val1_e : expandNext1) {
-                DEBUG_PRINT("Finding values outside context that alias with " << *val1_e << "\n");
-                val1_e = val1_e->stripPointerCasts();
+            //None of the values found so far need be in a function shared
+            //with the other pointer, so they are expanded
+            SmallPtrSet<Value*,4> expandNext_new;
+            for (Value *val_e : expandNext) {
+                DEBUG_PRINT("Finding values outside context that alias with " << *val_e << "\n");
+                val_e = val_e->stripPointerCasts();
                 bool canGetOutsideContext=false;
                 SmallPtrSet<Value*,2> oContext;
-                if (auto val1_i = dyn_cast<Instruction>(val1_e)) {
-                    oContext = getAliasedValuesOutsideContext(val1_i,foundGlobalForVal1);
+                if (auto val_i = dyn_cast<Instruction>(val_e)) {
+                    oContext = getAliasedValuesOutsideContext(val_i,foundGlobal);
                     canGetOutsideContext=true;
                 }
-                if (auto val1_a = dyn_cast<Argument>(val1_e)) {
-                    oContext = getAliasedValuesOutsideContext(val1_a);
+                if (auto val_a = dyn_cast<Argument>(val_e)) {
+                    oContext = getAliasedValuesOutsideContext(val_a);
                     canGetOutsideContext=true;
                 }
                 if (canGetOutsideContext) {
-                    for (Value * val1_oc : oContext) {
-                        val1_oc = val1_oc->stripPointerCasts();
-                        DEBUG_PRINT("Attempting to add value " << *val1_oc << " to the next expand set\n");
-                        if (compareTowards1.count(val1_oc) == 0)
-                            expandNext1_new.insert(val1_oc);
+                    for (Value *val_oc : oContext) {
+                        val_oc = val_oc->stripPointerCasts();
+                        DEBUG_PRINT("Attempting to add value " << *val_oc << " to the next expand set\n");
+                        if (alreadyFound.count(val_oc) == 0)
+                            expandNext_new.insert(val_oc);
                     }
                 }
             }
-            expandNext1=expandNext1_new;
-            SmallPtrSet<Value*,4> expandNext2_new;
-            for (Value * val2_e : expandNext2) {
-                DEBUG_PRINT("Finding values outside context that alias with " << *val2_e << "\n");
-                val2_e = val2_e->stripPointerCasts();
-                bool canGetOutsideContext=false;
-                SmallPtrSet<Value*,2> oContext;
-                if (auto val2_i = dyn_cast<Instruction>(val2_e)) {	
-                    oContext = getAliasedValuesOutsideContext(val2_i,foundGlobalForVal2);
-                    canGetOutsideContext=true;
-                }
-                if (auto val2_a = dyn_cast<Argument>(val2_e)) {	
-                    oContext = getAliasedValuesOutsideContext(val2_a);
-                    canGetOutsideContext=true;
-                }
-                if (canGetOutsideContext) {
-                    for (Value * val2_oc : oContext) {
-                        val2_oc = val2_oc->stripPointerCasts();
-                        DEBUG_PRINT("Attempting to add value " << *val2_oc << " to the next expand set\n");
-                        if (compareTowards2.count(val2_oc) == 0)
-                            expandNext2_new.insert(val2_oc);
-                    }
-                }
+            expandNext=expandNext_new;
+        }
+        lock_guard<mutex> lock(cacheMutex);
+        return comparableRootsDynamic.insert(make_pair(val,levels)).first->second;
+    }
+
+    //Lifts both values out of their functions in lockstep until one value
+    //of each can be compared. Each pointer is only lifted once, later pairs
+    //only match up the lifted values
+    pair<Value*,Value*> getComparableValues(Value *val1, Value* val2) {
+        const vector<vector<ContextValue> > &roots1 = getComparableRoots(val1);
+        const vector<vector<ContextValue> > &roots2 = getComparableRoots(val2);
+        static const vector<ContextValue> noValues;
+        for (unsigned level = 0; level < roots1.size() || level < roots2.size(); ++level) {
+            const vector<ContextValue> &expandNext1 = level < roots1.size() ? roots1[level] : noValues;
+            const vector<ContextValue> &expandNext2 = level < roots2.size() ? roots2[level] : noValues;
+            DEBUG_PRINT("Matching level " << level << ", sizes are: " << expandNext1.size() << " x " << expandNext2.size() << "\n");
+            //The values found at this level against everything found so far
+            for (const ContextValue &val1_e : expandNext1) {
+                for (unsigned prev = 0; prev < level && prev < roots2.size(); ++prev)
+                    for (const ContextValue &val2_c : roots2[prev])
+                        if (isComparable(val1_e,val2_c))
+                            return make_pair(val1_e.first,val2_c.first);
+                for (const ContextValue &val2_e : expandNext2)
+                    if (isComparable(val1_e,val2_e))
+                        return make_pair(val1_e.first,val2_e.first);
             }
-            expandNext2=expandNext2_new;
+            for (const ContextValue &val2_e : expandNext2)
+                for (unsigned prev = 0; prev < level && prev < roots1.size(); ++prev)
+                    for (const ContextValue &val1_c : roots1[prev])
+                        if (isComparable(val1_c,val2_e))
+                            return make_pair(val1_c.first,val2_e.first);
         }
         
         return make_pair((Value*)NULL,(Value*)NULL);
@@ -472,7 +768,7 @@ private:
         //for (Pass *results : aliasResults) {
         bool aliased=false;
         Function * parent = dyn_cast<Instruction>(ptr1)->getFunction();
-        AliasResult res = getAAResultsForFun(parent)->alias(ptr1,ptr2); 
+        AliasResult res = queryAAResultsForFun(parent,ptr1,ptr2); 
         switch (res) {
         case NoAlias:
             DEBUG_PRINT("Got NoAlias\n");
@@ -573,215 +869,16 @@ private:
         return isNotNull(CallSite(inst));
     }
     
-    //Utility: Returns the proper type of a pointer type
-    Type *getTypeOfPointerType(Type *ptr) {
-        while (PointerType *p = dyn_cast<PointerType>(ptr))
-            ptr = p->getElementType();
-        return ptr;
-    }
-
+    //Obtains the set of functions that can be immediately called when
+    //executing inst
     SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) {
         SmallPtrSet<Function*,1> toReturn;
-        SmallPtrSet<Value*,8> alreadyVisited;
-        if (isCallSite(inst)) {
-            CallSite call = CallSite(inst);
-            Value *calledValue = call.getCalledValue();
-            //Rather than doing this: would it be possible with a decent AA to just
-            //check if the value aliases with each function in the module?
-            deque<Value*> calledValues;
-            calledValues.push_back(calledValue);
-            while (!calledValues.empty()) {
-                Value *nextValue = calledValues.front();
-                calledValues.pop_front();
-                nextValue = nextValue->stripInBoundsConstantOffsets();
-                if (alreadyVisited.count(nextValue) != 0)
-                    continue;
-                alreadyVisited.insert(nextValue);
-                //Try to resolve the value into a function
-                if (auto fun = dyn_cast<Function>(nextValue)) {
-                    if (noAnalyzeFunctions.count(fun->getName()) == 0)
-                        toReturn.insert(fun);
-                }
-                //Since we are dealing with functions, only a few
-                //instructions should be possible
-                else if (auto phi = dyn_cast<PHINode>(nextValue))
-                    for (int i = 0; i < phi->getNumIncomingValues(); ++i)
-                        calledValues.push_back(phi->getIncomingValue(i));
-                else if (dyn_cast<Instruction>(nextValue) && isCallSite(dyn_cast<Instruction>(nextValue))) {
-                    //We get the return from a function, find all values
-                    //that could be returned from that function
-                    //and toss them onto the queue
-                    //TODO: Do we need to handle the case where functions are
-                    //returned recursively?
-                    //For now, ignore it
-                    SmallPtrSet<Function*,1> calledFuns = getCalledFuns(dyn_cast<Instruction>(nextValue));
-                    for (Function* fun : calledFuns) {
-                        for (auto instb = inst_begin(fun);
-                             instb != inst_end(fun); ++instb) {
-                            if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
-                                if (Value* returnval = returninst->getReturnValue())
-                                    calledValues.push_back(returnval);
-                            }
-                        }
-                    }
-                }
-                
-                //Here we pick apart data structures
-                else if (auto gep = dyn_cast<GetElementPtrInst>(nextValue)) {
-                    //Any remaining gep must, by definition, have a dynamic index
-                    //So we just resolve the value that is gepped from
-                    calledValues.push_back(gep->getPointerOperand());
-                }
-                else if (auto load = dyn_cast<LoadInst>(nextValue)) {
-                    calledValues.push_back(load->getPointerOperand());
-                }
-                else if (auto arg = dyn_cast<Argument>(nextValue)) {
-                    //Track values from the callsites
-                    for (auto use = arg->getParent()->users().begin();
-                         use != arg->getParent()->users().end();
-                         ++use) {
-                        if (dyn_cast<Instruction>(*use) && isCallSite(dyn_cast<Instruction>(*use))) {
-                            CallSite callsite(*use);
-                            calledValues.push_back(callsite.getArgOperand(arg->getArgNo()));
-                        }
-                    }
-                }
-                else if (auto glob = dyn_cast<GlobalVariable>(nextValue)) {
-                    //at this point we can basically give up, any function
-                    //that has its adress taken can be used here
-                    for (Function &fun : inst->getParent()->getParent()->getParent()->getFunctionList()) {
-                        if (fun.hasAddressTaken()) {
-                            if (fun.getFunctionType() == dyn_cast<FunctionType>(getTypeOfPointerType(glob->getType()))) {
-                                toReturn.insert(&fun);
-                            }
-                        }
-                    }
-                } else {
-                    //We failed to resolve function to be called. Print diagnostic message
-                    // VERBOSE_PRINT("Failed to resolve value: " << *nextValue
-                    //               << "\nwhich has type: " << typeid(*nextValue).name()
-                    //               << "\nwhile resolving called functions.\n");
-                }                    
-            }
-        }
+        for (Function *fun : callTargets->getCalledFuns(inst))
+            if (noAnalyzeFunctions.count(fun->getName()) == 0)
+                toReturn.insert(fun);
         return toReturn;
     }
     
-    bool escapeCheck(Value *val) {
-        if (!isa<PointerType>(val->getType()))
-            return false;
-        if (isa<GlobalValue>(val))
-            return true;
-        bool toReturn = false;
-        for (Use &use : val->uses()) {
-            Value * useval = use.get();
-            if (auto store = dyn_cast<StoreInst>(useval))
-                toReturn =  toReturn || escapeCheck(store->getPointerOperand());
-            if (auto load = dyn_cast<LoadInst>(useval))
-                toReturn = toReturn || false;
-            if (Instruction* useinst = dyn_cast<Instruction>(useval))
-                toReturn = toReturn || isCallSite(useinst);
-            toReturn = toReturn || escapeCheck(val);
-        }
-        return toReturn;
-    }
-
-    map<Value*,bool> canBeSharedDynamic;
-    bool canBeShared(Value *val) {
-        DEBUG_PRINT("Determining whether " << *val << " can be shared...\n");
-        if (canBeSharedDynamic.count(val) != 0) {
-            DEBUG_PRINT("Resolved " << *val << "dynamically to " << (canBeSharedDynamic[val] ? "true" : "false") << "\n");
-            return canBeSharedDynamic[val];
-        }
-        //This ensures that recursion does not break us
-        canBeSharedDynamic[val]=false;
-        
-        if (auto inst = dyn_cast<Instruction>(val)) {
-
-            SmallPtrSet<Function*,1> calledFuns=getCalledFuns(inst);
-            if (calledFuns.size() != 0)
-                DEBUG_PRINT("Is a call\n");
-            for (Function * calledFun : calledFuns) {
-                if (calledFun->getName().equals("malloc") ||
-                    calledFun->getName().equals("MyMalloc")
-                    ) {
-                    DEBUG_PRINT("Called malloc variant\n");
-                    if (escapeCheck(val)) {
-                        DEBUG_PRINT("Allocation escapes\n");
-                        return canBeSharedDynamic[val]=true;
-                    }
-                }
-                else {
-                    for (auto it = inst_begin(calledFun);
-                         it != inst_end(calledFun); ++it) {
-                        if (auto ret = dyn_cast<ReturnInst>(&*it))
-                            if (ret->getReturnValue() && canBeShared(ret->getReturnValue())) {
-                                DEBUG_PRINT("Determined " << *val << " could be shared through checking the return from a function\n"); 
-                                return canBeSharedDynamic[val]=true;
-                                
-                            }
-                    }
-                }
-            }
-        }
-        if (auto glob = dyn_cast<GlobalVariable>(val)) {
-            DEBUG_PRINT("Determined " << *val << " could be shared since it is a global\n");
-            return canBeSharedDynamic[val]=true;
-        }
-        if (auto arg = dyn_cast<Argument>(val)) {
-            if (arg->getParent()->hasAddressTaken()) {
-                DEBUG_PRINT("Determined " << *val << " could be shared since it is an argument to a function which has its address taken\n");
-                return canBeSharedDynamic[val]=true;
-            }
-            for (auto user : arg->getParent()->users()) {
-                if (Instruction *inst = dyn_cast<Instruction>(user)) {
-                    if (isCallSite(inst)) {
-                        CallSite call(inst);
-                        if (canBeShared(call.getArgument(arg->getArgNo())))
-                            DEBUG_PRINT("Determined " << *val << " could be shared since it is an argument to a function where a parameter passed in could be shared\n");
-                            return canBeSharedDynamic[val]=true;
-                    }
-                }
-            }
-        }
-        
-        if (auto load = dyn_cast<LoadInst>(val)) {
-            bool recurseCouldBeShared = canBeSharedDynamic[val]=canBeShared(load->getPointerOperand());
-            DEBUG_PRINT("Determined " << *val << " could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared since it is a load from a pointer that could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared\n");
-            return recurseCouldBeShared;
-        }
-        //This shouldn't actually be possible?
-        if (auto store = dyn_cast<StoreInst>(val)) {
-            bool recurseCouldBeShared = canBeSharedDynamic[val]=canBeShared(store->getPointerOperand());
-            DEBUG_PRINT("Determined " << *val << " could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared since it is a store to a pointer that could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared\n");
-            return recurseCouldBeShared;
-            //return canBeSharedDynamic[val]=canBeShared(store->getPointerOperand());
-        }
-        if (auto gep = dyn_cast<GetElementPtrInst>(val)) {
-            bool recurseCouldBeShared = canBeSharedDynamic[val]=canBeShared(gep->getPointerOperand());
-            DEBUG_PRINT("Determined " << *val << " could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared since it is a GEP of a pointer that could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared\n");
-            return recurseCouldBeShared;
-            //return canBeSharedDynamic[val]=canBeShared(gep->getPointerOperand());
-        }
-        if (auto phi = dyn_cast<PHINode>(val)) {
-            bool recurseCouldBeShared = false;
-            for (Use &use : cast<PHINode>(val)->incoming_values()) {
-                recurseCouldBeShared=canBeShared(use.get()) || recurseCouldBeShared;
-            }
-            DEBUG_PRINT("Determined " << *val << " could " << (recurseCouldBeShared ? "" : "not " ) <<  "be shared since it is a phiNode from values of which " << (recurseCouldBeShared ? "at least one " : "none " ) <<  "could be shared\n");
-            return canBeSharedDynamic[val]=recurseCouldBeShared;
-        }
-
-        if (val->stripPointerCasts() != val)
-            if (canBeShared(val->stripPointerCasts())) {
-                DEBUG_PRINT("Determined " << *val << " could be shared since it is an dynamic GEP of a pointer that could be shared\n");
-                return canBeSharedDynamic[val]=true;
-            }
-
-        DEBUG_PRINT("Handling of " << *val << " fell through\n");
-        return canBeSharedDynamic[val]=false;
-    }
-
     SmallPtrSet<Value*,4> getArguments(Instruction *inst) {
         SmallPtrSet<Value*,4> args;
         if (auto inst_load = dyn_cast<LoadInst>(inst))
@@ -794,6 +891,17 @@ private:
                     args.insert(arg.get());
         return args;
     }
+
+    SmallPtrSet<Value*,4> getSharedArguments(Instruction *inst) {
+        SmallPtrSet<Value*,4> args;
+        for (Value *arg : getArguments(inst)) {
+            if (isa<PointerType>(arg->getType()) && threadSharing->isShared(arg))
+                args.insert(arg);
+            else
+                LIGHT_PRINT("Determined " << *arg << " cannot be shared between threads\n");
+        }
+        return args;
+    }
 };
     
 #endif
@@ -10,8 +10,16 @@
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include <list>
+#include <set>
+#include <map>
+#include <mutex>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
 
 #include "../ThreadDependence/ThreadDependence.cpp"
+#include "../CallTargetIndex/CallTargetIndexPass.cpp"
 
 // // #include "llvm/Analysis/ScalarEvolution.h"
 // #include "llvm/Analysis/ScalarEvolutionExpressions.h"
@@ -40,524 +48,495 @@ static cl::opt<bool> AssumeDependantIndexesDontAlias("no-dependant-index-noalias
 //bool AssumeDGEPNoAlias = false;
 static cl::opt<bool> AssumeDGEPNoAlias("degep-noalias",cl::desc("Assume that GEP indices which are dynamic make GEPs safe"),cl::init(true));
 
-Module *usechain_wm;
-Pass *callingPass;
+//The offsets applied to a bottom level value to reach a pointer, outermost
+//last. An offset of -1 is dynamic, -2 is dynamic and depends on thread
+//arguments. Paths are interned in an AccessPathPool, so equal paths are the
+//same object
+class AccessPath {
+public:
+  typedef SmallVector<int,4> Offsets;
+
+  explicit AccessPath(const Offsets &offsets) : offsets(offsets) {}
+
+  const Offsets offsets;
+
+  //Whether the paths may lead to the same location, and whether they must
+  //because no offset on either is dynamic
+  void compare(const AccessPath *other, bool &mayMatch, bool &strictMatch) const {
+    mayMatch = (this == other || offsets.size() == other->offsets.size());
+    strictMatch = mayMatch;
+    for (unsigned i = 0; mayMatch && i < offsets.size(); ++i) {
+      int offset = offsets[i], otherOffset = other->offsets[i];
+      DEBUG_PRINT("Comparing " << offset << " and " << otherOffset << "\n");
+      if (offset == -2 || otherOffset == -2) {
+        DEBUG_PRINT("Atleast one of the indices were dynamic and depends on thread arguments. Optimistically the index lists are then different\n"); 
+        mayMatch = false;
+      } else if (offset == -1 || otherOffset == -1) {
+        DEBUG_PRINT("Atleast one index was dynamic\n");
+        strictMatch = false;
+      } else if (offset != otherOffset) {
+        DEBUG_PRINT("Indexes were different\n");
+        mayMatch = false;
+      }
+    }
+  }
+};
 
-// DEPRECATED
-// //Gets the called function of a callsite irregardless of casts
-// Function *getStripCall(CallSite *callsite) {
-//   Value *toReturn = callsite->getCalledValue()->stripPointerCasts();
-//   return dyn_cast<Function>(toReturn);               
-// }
+//Owns the interned access paths
+class AccessPathPool {
+public:
+  AccessPathPool() {}
 
-//Verifies that a CallSite is not null-initialized
-bool isNotNull(CallSite call) {
-  return call.isCall() || call.isInvoke();
-}
-
-//Verifies that an instruction can be a callsite
-bool isCallSite(Instruction* inst) {
-  return isNotNull(CallSite(inst));
-}
-
-//Utility: Returns the proper type of a pointer type
-Type *getTypeOfPointerType(Type *ptr) {
-  while (PointerType *p = dyn_cast<PointerType>(ptr))
-    ptr = p->getElementType();
-  return ptr;
-}
-
-//Obtains the set of functions that can be immediately called when
-//executing inst
-SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) {
-  //LIGHT_PRINT("Finding functions that can be called by " << *inst << "\n");
-  SmallPtrSet<Function*,1> toReturn;
-  SmallPtrSet<Value*,8> alreadyVisited;
-  if (isCallSite(inst)) {
-    //DEBUG_PRINT("which is a callsite\n");
-    CallSite call = CallSite(inst);
-    Value *calledValue = call.getCalledValue();
-    //Rather than doing this: would it be possible with a decent AA to just
-    //check if the value aliases with each function in the module?
-    deque<Value*> calledValues;
-    calledValues.push_back(calledValue);
-    while (!calledValues.empty()) {
-      Value *nextValue = calledValues.front();
-      calledValues.pop_front();
-      nextValue = nextValue->stripInBoundsConstantOffsets();
-      if (alreadyVisited.count(nextValue) != 0)
-	continue;
-      alreadyVisited.insert(nextValue);
-      //Try to resolve the value into a function
-      if (auto fun = dyn_cast<Function>(nextValue)) {
-	//LIGHT_PRINT(fun->getName() << " could be called\n");
-	toReturn.insert(fun);
-      }
-      //Since we are dealing with functions, only a few
-      //instructions should be possible
-      else if (auto phi = dyn_cast<PHINode>(nextValue))
-	for (int i = 0; i < phi->getNumIncomingValues(); ++i)
-	  calledValues.push_back(phi->getIncomingValue(i));
-      else if (dyn_cast<Instruction>(nextValue) && isCallSite(dyn_cast<Instruction>(nextValue))) {
-	//We get the return from a function, find all values
-	//that could be returned from that function
-	//and toss them onto the queue
-	//TODO: Do we need to handle the case where functions are
-	//returned recursively?
-	//For now, ignore it
-	SmallPtrSet<Function*,1> calledFuns = getCalledFuns(dyn_cast<Instruction>(nextValue));
-	for (Function* fun : calledFuns) {
-	  for (auto instb = inst_begin(fun);
-	       instb != inst_end(fun); ++instb) {
-	    if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
-	      if (Value* returnval = returninst->getReturnValue())
-		calledValues.push_back(returnval);
-	    }
-	  }
-	}
-      }
-      //Return a dummy "Null" value
-      else if (auto inlineasm = dyn_cast<InlineAsm>(nextValue)) {
-      	//LIGHT_PRINT("Could call assembly\n");
-	toReturn.insert(NULL);
-      }
-      //Here we pick apart data structures
-      else if (auto gep = dyn_cast<GetElementPtrInst>(nextValue)) {
-	//Any remaining gep must, by definition, have a dynamic index
-	//So we just resolve the value that is gepped from
-	calledValues.push_back(gep->getPointerOperand());
+  ~AccessPathPool() {
+    for (auto &bucket : pathsOfHash)
+      for (const AccessPath *path : bucket.second)
+        delete path;
+  }
+
+  const AccessPath *intern(const AccessPath::Offsets &offsets) {
+    lock_guard<mutex> lock(poolMutex);
+    size_t hash = hash_combine_range(offsets.begin(),offsets.end());
+    SmallVector<const AccessPath*,1> &bucket = pathsOfHash[hash];
+    for (const AccessPath *path : bucket)
+      if (path->offsets == offsets)
+        return path;
+    bucket.push_back(new AccessPath(offsets));
+    return bucket.back();
+  }
+
+private:
+  map<size_t,SmallVector<const AccessPath*,1> > pathsOfHash;
+  mutex poolMutex;
+};
+
+//Resolves pointers to the globals they are derived from, together with the
+//list of offsets applied on the way, and compares pointers through those.
+//The bottom level values of a pointer are computed once and kept, so a
+//pointer that takes part in many comparisons is only walked once. All state
+//is held by the object
+class UseChainAliasing {
+public:
+  //The access paths of a pointer grouped by the bottom level value they
+  //start from. Escaped allocations have a NULL bottom level value
+  typedef DenseMap<Value*,SmallPtrSet<const AccessPath*,2> > BottomLevelValues;
+
+  UseChainAliasing(Module *module, Pass *callingPass) :
+    module(module), callingPass(callingPass),
+    callTargets(&callingPass->getAnalysis<CallTargetIndexPass>().getIndex()) {}
+
+  AliasResult pointerAlias(Value *pt1, Value *pt2) {
+    VERBOSE_PRINT("Comparing " << *pt1 << " and " << *pt2 << "\n");
+    //errs() << "Usechainpointeralias is comparing " << *pt1 << " and " << *pt2 << "\n";
+    //The comparison is symmetric, so both orders share a cache entry
+    pair<Value*,Value*> key = pt1 < pt2 ? make_pair(pt1,pt2) : make_pair(pt2,pt1);
+    {
+      lock_guard<mutex> lock(cacheMutex);
+      auto found = pointerAliasDynamic.find(key);
+      if (found != pointerAliasDynamic.end()) {
+        VERBOSE_PRINT("Dynamically resolved to  " << found->second << "\n");
+        return found->second;
       }
-      // if (auto ext = dyn_cast<ExtractElementInst>(nextValue)) {
-      //     int index = -1;
-      //     if (auto cons = dyn_cast<Constant>(ext->getIndexOperand)) {
-      //         nextValues.push_back(ext->getVectorOperand()->
-      //     }
-      // }
-      else if (auto load = dyn_cast<LoadInst>(nextValue)) {
-	calledValues.push_back(load->getPointerOperand());
+    }
+
+    const BottomLevelValues &bottomUsesPt1 = getBottomLevelValues(pt1);
+    const BottomLevelValues &bottomUsesPt2 = getBottomLevelValues(pt2);
+
+    //errs() << "pt1 bUses size: " << bottomUsesPt1.size() << "\n";
+    //errs() << "pt2 bUses size: " << bottomUsesPt2.size() << "\n";
+  
+    LIGHT_PRINT(*pt1 << " bottomUserSize " << bottomUsesPt1.size() << "\n");
+    LIGHT_PRINT(*pt2 << " bottomUserSize " << bottomUsesPt2.size() << "\n");
+  
+    AliasResult toReturn = NoAlias;
+
+    //Only paths from the same bottom level value can alias, so the groups
+    //of the smaller side are looked up in the other. The first pair of
+    //paths that is not NoAlias decides
+    bool swapped = bottomUsesPt2.size() < bottomUsesPt1.size();
+    const BottomLevelValues &lookupFrom = swapped ? bottomUsesPt2 : bottomUsesPt1;
+    const BottomLevelValues &lookupIn = swapped ? bottomUsesPt1 : bottomUsesPt2;
+    for (BottomLevelValues::const_iterator group = lookupFrom.begin(),
+           end_group = lookupFrom.end();
+         group != end_group && !toReturn; ++group) {
+      if (!group->first) {
+        LIGHT_PRINT("Skipped BLU comparison due to one of the BLUs having a null source\n");
+        continue;
       }
-      else if (auto arg = dyn_cast<Argument>(nextValue)) {
-	//Track values from the callsites
-	for (auto use = arg->getParent()->users().begin();
-	     use != arg->getParent()->users().end();
-	     ++use) {
-	  if (dyn_cast<Instruction>(*use) && isCallSite(dyn_cast<Instruction>(*use))) {
-	    CallSite callsite(*use);
-	    calledValues.push_back(callsite.getArgOperand(arg->getArgNo()));
-	  }
-	}
+      BottomLevelValues::const_iterator otherGroup = lookupIn.find(group->first);
+      if (otherGroup == lookupIn.end())
+        continue;
+      LIGHT_PRINT("Comparing paths from BLU: " << *(group->first) << "\n");
+      for (auto path = group->second.begin(), end_path = group->second.end();
+           path != end_path && !toReturn; ++path) {
+        for (auto otherPath = otherGroup->second.begin(), end_otherPath = otherGroup->second.end();
+             otherPath != end_otherPath && !toReturn; ++otherPath) {
+          bool mayMatch, strictMatch;
+          (*path)->compare(*otherPath,mayMatch,strictMatch);
+          if (!mayMatch) {
+            LIGHT_PRINT("BLUs did not alias as their indexing lists were different\n");
+            continue;
+          }
+          if (!strictMatch) {
+            LIGHT_PRINT("BLUs may alias\n");
+            toReturn = MayAlias;
+          } else {
+            LIGHT_PRINT("BlUs must alias\n");
+            toReturn = MustAlias;
+          }
+        }
       }
-      else if (auto glob = dyn_cast<GlobalVariable>(nextValue)) {
-	//at this point we can basically give up, any function
-	//that has its adress taken can be used here
-	//LIGHT_PRINT(*inst << " calls a function stored in a global, finding functions that have their address taken. Global is: " << *glob << "\n");
-	for (Function &fun : inst->getParent()->getParent()->getParent()->getFunctionList()) {
-	  //LIGHT_PRINT("Considering function: " << fun.getName() << "\n");
-	  if (fun.hasAddressTaken()) {
-	    //LIGHT_PRINT("It has its adress taken\n");
-	    if (fun.getFunctionType() == dyn_cast<FunctionType>(getTypeOfPointerType(glob->getType()))) {
-	      toReturn.insert(&fun);
-	    }
-	  }
-	}
-      } else {
-	//We failed to resolve function to be called. Print diagnostic message
-	VERBOSE_PRINT("Failed to resolve value: " << *nextValue
-		      << "\nwhich has type: " << typeid(*nextValue).name()
-		      << "\nwhile resolving called functions.\n");
-      }                    
     }
+  
+    VERBOSE_PRINT("Determined to " << toReturn << "\n");
+    lock_guard<mutex> lock(cacheMutex);
+    return pointerAliasDynamic[key]=toReturn;
   }
-  return toReturn;
-}
-
-
-//Attempts to resolve a value to an integer using scalar evolution
-//Is only more powerfull than constant folding in loops, where it will
-//reduce an iterative variable to its base value
-bool isBaseConstantInLoopSCEV(Value *val, ConstantInt **base, Function *containingFun) {
-  DEBUG_PRINT("Simplifying " << *val << " using SCEV analysis\n");
-  ScalarEvolution &SE = callingPass->getAnalysis<ScalarEvolutionWrapperPass>(*containingFun).getSE();
-  const SCEV* scev_val = SE.getSCEV(val);
-  // errs() << "Resolving SCEV for val: " << *val << " - ";
-  // scev_val->print(errs());
-  // errs() << "\n";
-  while (!isa<SCEVConstant>(scev_val)) {
-    if (auto scev_rec = dyn_cast<SCEVAddRecExpr>(scev_val)) {
-      scev_val = scev_rec->getStart();
-      continue;
+
+  //Returns the bottom level values of val, walking its use chain the first
+  //time it is asked for
+  const BottomLevelValues &getBottomLevelValues(Value *val) {
+    {
+      lock_guard<mutex> lock(cacheMutex);
+      auto found = bottomLevelValuesDynamic.find(val);
+      if (found != bottomLevelValuesDynamic.end())
+        return found->second;
     }
-    // errs() << "Resolution failed, stopped at: ";
-    // scev_val->print(errs());
-    // errs() << "\n";
-    DEBUG_PRINT("Failed, remaining SCEV was: " << *scev_val << "\n");
-    return false;
+    //Values met further down a walk are cut off to break cycles, so only
+    //the results of whole walks are kept
+    SmallPtrSet<Value*,32> visited;
+    BottomLevelValues values = findBottomLevelValues_(val,visited);
+    lock_guard<mutex> lock(cacheMutex);
+    return bottomLevelValuesDynamic.insert(make_pair(val,values)).first->second;
   }
-  *base = dyn_cast<SCEVConstant>(scev_val)->getValue();
-            
-  // if (scev_val != SE->getSCEV(val)) {
-  //     errs() << "Resolved non-constant to: " << **base << "\n";
+
+private:
+  Module *module;
+  Pass *callingPass;
+  CallTargetIndex *callTargets;
+
+  //Guards the caches, the walks themselves only use local state
+  mutex cacheMutex;
+  map<Value*,BottomLevelValues> bottomLevelValuesDynamic;
+  map<pair<Value*,Value*>,AliasResult> pointerAliasDynamic;
+  AccessPathPool accessPaths;
+
+  // DEPRECATED
+  // //Gets the called function of a callsite irregardless of casts
+  // Function *getStripCall(CallSite *callsite) {
+  //   Value *toReturn = callsite->getCalledValue()->stripPointerCasts();
+  //   return dyn_cast<Function>(toReturn);               
   // }
-  DEBUG_PRINT("Sucessfully reduced to " << **base << "\n");
-  return true;
-  //return false;
-}
-
-
-//Returns whether any index of the dynamic gep depends on a thread argument
-bool gepDependsOnThreadArgument(Value *GEP) {
-  DEBUG_PRINT("Checking whether indices to " << *GEP << " could depend on thread arguments\n");
-  ThreadDependence &TD = callingPass->getAnalysis<ThreadDependence>();
-  for (auto it = dyn_cast<GetElementPtrInst>(GEP)->idx_begin(),
-	 et = dyn_cast<GetElementPtrInst>(GEP)->idx_end();
-       it != et; ++it) {
-    if (TD.dependsOnThread(*it)) {
-      DEBUG_PRINT(**it << " could depend on thread arguments\n");
-      return true;
-    }
-  }
-  DEBUG_PRINT("They could not\n");
-  return false;
-}
-
-
-//Returns wether the dynamic gep was resolved
-bool handleDynamicGEP(Value **pt_,APInt &offset) {
-  //errs() << "!Detected dynamic use of GEP: " << **pt_ << ", #yolo-ing it\n";                    
-  //Basically, we will try to get a constantExpr out of
-  //the index and then manually recalculate our offset
-  //and set the stripped value to it's pointer
-  int offsetint = 0;
-  Value *pt = *pt_;
-  DEBUG_PRINT("Trying to resolve dynamic GEP " << *pt << "\n");
-  Function *containingFun = dyn_cast<Function>(dyn_cast<Instruction>(*pt_)->getParent()->getParent());
-  Type* nextType = dyn_cast<CompositeType>(dyn_cast<GetElementPtrInst>(pt)->getPointerOperand()->getType());
-
-  for (auto it = dyn_cast<GetElementPtrInst>(pt)->idx_begin(),
-	 et = dyn_cast<GetElementPtrInst>(pt)->idx_end();
-       it != et; ++it) {
-    DEBUG_PRINT("Resolving index: " << *it << "\n");
-    assert(isa<CompositeType>(nextType) && "Broken Dynamic GEP detected");
-    CompositeType *currType = cast<CompositeType>(nextType);
-    ConstantInt *constant = NULL;
-
-    bool isConstant = isBaseConstantInLoopSCEV(*it, &constant,containingFun);
-    if (!isConstant) {
-      DEBUG_PRINT("Was not constant when using SCEV\n");
-      offsetint = -1;
-      break;
-    }
-    int curroffset = constant->getZExtValue();
-    nextType = currType->getTypeAtIndex(curroffset);
 
-    // Handle a struct index, which adds its field offset to the pointer.
-    if (StructType *STy = dyn_cast<StructType>(currType)) {
-      const StructLayout *SL = usechain_wm->getDataLayout().getStructLayout(STy);
-      offsetint += SL->getElementOffset(curroffset);
-    } else {
-      // For array or vector indices, scale the index by the size of the type.
-      offsetint += curroffset *
-	usechain_wm->getDataLayout().getTypeAllocSize(nextType);
-    }
+  //Verifies that a CallSite is not null-initialized
+  static bool isNotNull(CallSite call) {
+    return call.isCall() || call.isInvoke();
   }
-  *pt_ = cast<GetElementPtrInst>(pt)->getPointerOperand();
-  if (offsetint >= 0) {
-    DEBUG_PRINT("Fully resolved dynamic GEP\n");
-    //errs() << "Resolved Dynamic GEP" << "\n";
-    offset += APInt(offset.getBitWidth(),offsetint);
-    return true;
-  } else {
-    DEBUG_PRINT("Failed to resolve dynamic GEP\n");
-    //offset += APInt(offset.getBitWidth(),0);
-    return false;
-    //errs() << "YOLO-ed Dynamic GEP" << "\n";
-    //*pt_ = NULL;
-  }
-}
 
-//Checks whether the address val might escape the local context
-bool escapeCheck(Value *val) {
-  DEBUG_PRINT("Checking whether memory reffered to by " << *val << " might escape context");
-  if (!isa<PointerType>(val->getType())) {
-    DEBUG_PRINT("Not a pointer, so false");
-    return false;
+  //Verifies that an instruction can be a callsite
+  static bool isCallSite(Instruction* inst) {
+    return isNotNull(CallSite(inst));
   }
-  if (isa<GlobalValue>(val)) {
-    DEBUG_PRINT("Is a global, so true");
-    return true;
-  }
-  bool toReturn = false;
-  DEBUG_PRINT("Checking uses\n");
-  for (Use &use : val->uses()) {
-    Value * useval = use.get();
-    if (auto store = dyn_cast<StoreInst>(useval))
-      toReturn =  toReturn || escapeCheck(store->getPointerOperand());
-    if (auto load = dyn_cast<LoadInst>(useval))
-      toReturn = toReturn || false;
-    if (Instruction* useinst = dyn_cast<Instruction>(useval)) {
-      toReturn = toReturn || isCallSite(useinst);
-    }
-    toReturn = toReturn || escapeCheck(val);
+
+  //Obtains the set of functions that can be immediately called when
+  //executing inst. Calls to inline assembly are returned as a NULL entry
+  SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) {
+    CallTargetIndex::CallTargets targets = callTargets->getCallTargets(inst);
+    //Return a dummy "Null" value
+    if (targets.callsAsm)
+      targets.funs.insert(NULL);
+    return targets.funs;
   }
-  DEBUG_PRINT("Determined to" << (toReturn ? "" : " not") << " escape\n");
-  return toReturn;
-}
-
-SmallPtrSet<Value*,1024> visitedBottomLevelValues;
-        
-        
-set<pair<Value*,list<int> > > findBottomLevelValues_(Value *val) {
-  DEBUG_PRINT("Finding bottom level values of " << *val << "\n");
-  int pointerSize = usechain_wm->getDataLayout().getPointerSizeInBits(cast<PointerType>(val->getType())->getAddressSpace());
-  APInt offset = APInt(pointerSize,0);
-  Value* strip = val->stripAndAccumulateInBoundsConstantOffsets(usechain_wm->getDataLayout(),offset);
-  int intoffset = offset.getLimitedValue();
-  set<pair<Value*,list<int> > > toReturn;
-  bool appendOffset = true;
-  SmallPtrSet<Value*,2> nextPointers;
-  
-  if (visitedBottomLevelValues.count(val) != 0)
-    return toReturn;
-  visitedBottomLevelValues.insert(val);
-            
-  //These are bottom level values, they modify toReturn directly
-  //and do not add pointers to nextPointers
-  if (auto inst = dyn_cast<Instruction>(strip)) {
-    if (isCallSite(inst)) {
-      DEBUG_PRINT("When stripped is callsite " << *inst << "\n");
-      SmallPtrSet<Function*,1> calledFuns = getCalledFuns(inst);
-      for (Function* fun : calledFuns) {
-	//Inline asm case
-	if (!fun) {
-	  //Add parameters to nextPointers, scramble current list
-	  intoffset = -1;
-	  CallSite call(inst);
-	  for (auto arg_beg = call.arg_begin();
-	       arg_beg != call.arg_end(); ++arg_beg) {
-	    nextPointers.insert(*arg_beg);
-	  }
-	}
-	//Assume we know the names of all allocation functions
-	if (fun->getName().equals("malloc") ||
-	    fun->getName().equals("MyMalloc")) {
-	  if (escapeCheck(strip)) {
-	    toReturn.insert(make_pair((Value*)NULL,list<int>(1,intoffset)));
-	    DEBUG_PRINT("Which is an escaped allocation: \n");
-	  } else {
-	    DEBUG_PRINT("Which is not an escaped allocation: \n");
-	  }
-	}
-	else {
-	  appendOffset=false;
-	  //Find the return values of the function
-	  for (auto instb = inst_begin(fun);
-	       instb != inst_end(fun); ++instb) {
-	    if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
-	      if (Value* returnval = returninst->getReturnValue()) {
-		DEBUG_PRINT("Added " << *(returnval) << " to nextpointers based on " << *inst << " has return " << *returninst << "\n");
-		nextPointers.insert(returnval);
-	      }
-	    }
-	  }
-	}
+
+
+  //Attempts to resolve a value to an integer using scalar evolution
+  //Is only more powerfull than constant folding in loops, where it will
+  //reduce an iterative variable to its base value
+  bool isBaseConstantInLoopSCEV(Value *val, ConstantInt **base, Function *containingFun) {
+    DEBUG_PRINT("Simplifying " << *val << " using SCEV analysis\n");
+    ScalarEvolution &SE = callingPass->getAnalysis<ScalarEvolutionWrapperPass>(*containingFun).getSE();
+    const SCEV* scev_val = SE.getSCEV(val);
+    // errs() << "Resolving SCEV for val: " << *val << " - ";
+    // scev_val->print(errs());
+    // errs() << "\n";
+    while (!isa<SCEVConstant>(scev_val)) {
+      if (auto scev_rec = dyn_cast<SCEVAddRecExpr>(scev_val)) {
+        scev_val = scev_rec->getStart();
+        continue;
       }
+      // errs() << "Resolution failed, stopped at: ";
+      // scev_val->print(errs());
+      // errs() << "\n";
+      DEBUG_PRINT("Failed, remaining SCEV was: " << *scev_val << "\n");
+      return false;
     }
+    *base = dyn_cast<SCEVConstant>(scev_val)->getValue();
+
+    // if (scev_val != SE->getSCEV(val)) {
+    //     errs() << "Resolved non-constant to: " << **base << "\n";
+    // }
+    DEBUG_PRINT("Sucessfully reduced to " << **base << "\n");
+    return true;
+    //return false;
   }
-  if (auto glob = dyn_cast<GlobalVariable>(strip)) {
-    DEBUG_PRINT("When stripped is global " << *glob << "\n");
-      //errs() << "Stripped value is global\n";
-    //errs() << "Found global: " << *glob << "\n";
-    toReturn.insert(make_pair(glob,list<int>(1,intoffset)));
-  }
-  if (auto arg = dyn_cast<Argument>(strip)) {
-    DEBUG_PRINT("When stripped is argument " << *arg << "\n");
-    //errs() << "Stripped value is argument\n";
-    //errs() << "Found argument: " << *arg << "\n";
-    for (auto user : arg->getParent()->users()) {
-      if (Instruction *inst = dyn_cast<Instruction>(user)) {
-	if (isCallSite(inst)) {
-	  CallSite call(inst);
-	  appendOffset = false;
-	  DEBUG_PRINT("Added " << *(call.getArgument(arg->getArgNo())) << " to nextpointers based on " << *inst << "\n");
-	  nextPointers.insert(call.getArgument(arg->getArgNo()));
-	}
+
+
+  //Returns whether any index of the dynamic gep depends on a thread argument
+  bool gepDependsOnThreadArgument(Value *GEP) {
+    DEBUG_PRINT("Checking whether indices to " << *GEP << " could depend on thread arguments\n");
+    ThreadDependence &TD = callingPass->getAnalysis<ThreadDependence>();
+    for (auto it = dyn_cast<GetElementPtrInst>(GEP)->idx_begin(),
+           et = dyn_cast<GetElementPtrInst>(GEP)->idx_end();
+         it != et; ++it) {
+      if (TD.dependsOnThread(*it)) {
+        DEBUG_PRINT(**it << " could depend on thread arguments\n");
+        return true;
       }
     }
-    //toReturn.insert(make_pair((Value*)NULL,list<int>(1,intoffset)));
+    DEBUG_PRINT("They could not\n");
+    return false;
   }
 
-  //These are the recursive cases, they add pointers to nextPointers
-  //and define how to merge offsets
-  if (auto load = dyn_cast<LoadInst>(strip)) {
-    DEBUG_PRINT("When stripped is load " << *load << ", added pointer operand to nextpointers\n");
-    nextPointers.insert(load->getPointerOperand());
-  }
-  if (auto dyngep = dyn_cast<GetElementPtrInst>(strip)) {
-    DEBUG_PRINT("When stripped is dynamic gep " << *dyngep << ", added pointer operand to nextpointers\n");
-    nextPointers.insert(dyngep->getPointerOperand());
-    appendOffset = false;
-
-    if (AssumeDependantIndexesDontAlias && gepDependsOnThreadArgument(dyngep)) {
-      DEBUG_PRINT("Determined to vary based on thread arguments\n");
-      intoffset = -2;
-    } else if (AssumeDGEPAliasConstBase) {
-      DEBUG_PRINT("Attempting to resolve dynamic GEP using SCEV\n");
-      if (!handleDynamicGEP(&strip,offset)) {
-	DEBUG_PRINT("Did not manage to resolve dynamic GEP\n");
-	if (!AssumeDGEPNoAlias) {
-	  DEBUG_PRINT("Conservatively set offset to dynamic\n");
-	  intoffset = -1;
-	} else {
-	  DEBUG_PRINT("Optimistically discarded this comparison route\n");
-	  nextPointers.erase(dyngep->getPointerOperand());
-	}
-      } else {
-	DEBUG_PRINT("Resolved dynamic GEP to" << offset.getLimitedValue() << "\n");
-	intoffset = offset.getLimitedValue();
+
+  //Returns wether the dynamic gep was resolved
+  bool handleDynamicGEP(Value **pt_,APInt &offset) {
+    //errs() << "!Detected dynamic use of GEP: " << **pt_ << ", #yolo-ing it\n";                    
+    //Basically, we will try to get a constantExpr out of
+    //the index and then manually recalculate our offset
+    //and set the stripped value to it's pointer
+    int offsetint = 0;
+    Value *pt = *pt_;
+    DEBUG_PRINT("Trying to resolve dynamic GEP " << *pt << "\n");
+    Function *containingFun = dyn_cast<Function>(dyn_cast<Instruction>(*pt_)->getParent()->getParent());
+    Type* nextType = dyn_cast<CompositeType>(dyn_cast<GetElementPtrInst>(pt)->getPointerOperand()->getType());
+
+    for (auto it = dyn_cast<GetElementPtrInst>(pt)->idx_begin(),
+           et = dyn_cast<GetElementPtrInst>(pt)->idx_end();
+         it != et; ++it) {
+      DEBUG_PRINT("Resolving index: " << *it << "\n");
+      assert(isa<CompositeType>(nextType) && "Broken Dynamic GEP detected");
+      CompositeType *currType = cast<CompositeType>(nextType);
+      ConstantInt *constant = NULL;
+
+      bool isConstant = isBaseConstantInLoopSCEV(*it, &constant,containingFun);
+      if (!isConstant) {
+        DEBUG_PRINT("Was not constant when using SCEV\n");
+        offsetint = -1;
+        break;
       }
-    } else {
-      if (!AssumeDGEPNoAlias) {
-	DEBUG_PRINT("Conservatively set offset to dynamic\n");
-	intoffset = -1;
+      int curroffset = constant->getZExtValue();
+      nextType = currType->getTypeAtIndex(curroffset);
+
+      // Handle a struct index, which adds its field offset to the pointer.
+      if (StructType *STy = dyn_cast<StructType>(currType)) {
+        const StructLayout *SL = module->getDataLayout().getStructLayout(STy);
+        offsetint += SL->getElementOffset(curroffset);
       } else {
-	nextPointers.erase(dyngep->getPointerOperand());
-	DEBUG_PRINT("Optimistically discarded this comparison route\n");
+        // For array or vector indices, scale the index by the size of the type.
+        offsetint += curroffset *
+          module->getDataLayout().getTypeAllocSize(nextType);
       }
     }
+    *pt_ = cast<GetElementPtrInst>(pt)->getPointerOperand();
+    if (offsetint >= 0) {
+      DEBUG_PRINT("Fully resolved dynamic GEP\n");
+      //errs() << "Resolved Dynamic GEP" << "\n";
+      offset += APInt(offset.getBitWidth(),offsetint);
+      return true;
+    } else {
+      DEBUG_PRINT("Failed to resolve dynamic GEP\n");
+      //offset += APInt(offset.getBitWidth(),0);
+      return false;
+      //errs() << "YOLO-ed Dynamic GEP" << "\n";
+      //*pt_ = NULL;
+    }
   }
 
-  if (auto phi = dyn_cast<PHINode>(strip)) {
-    DEBUG_PRINT("When stripped is phinode " << *phi << "\n");
-    appendOffset = false;
-    for (Use &use : cast<PHINode>(strip)->incoming_values()) {
-      DEBUG_PRINT("Added " << *(use.get()) << " to nextpointers\n");
-      nextPointers.insert(use.get());
+  //Checks whether the address val might escape the local context
+  bool escapeCheck(Value *val) {
+    DEBUG_PRINT("Checking whether memory reffered to by " << *val << " might escape context");
+    if (!isa<PointerType>(val->getType())) {
+      DEBUG_PRINT("Not a pointer, so false");
+      return false;
     }
-  }
-    
-#define UNIFY_OFFSETS(X,Y) ((X == -1 || Y == -1) ? -1 : X+Y)
-    
-  DEBUG_PRINT("Resolving nextpointers\n");
-  
-  for (Value* nextPoint : nextPointers) {
-    DEBUG_PRINT("Resolving " << *nextPoint << "\n");
-    set<pair<Value*,list<int> > > hasReturn = findBottomLevelValues_(nextPoint);
-    for (set<pair<Value*,list<int> > >::iterator retPair = hasReturn.begin(),
-	   end_retPair = hasReturn.end(); retPair != end_retPair; ++retPair) {
-      list<int> newList = retPair->second;
-      if (appendOffset)
-	newList.push_back(intoffset);
-      else {
-	int oldlatest = newList.back();
-	newList.pop_back();
-	newList.push_back(UNIFY_OFFSETS(oldlatest,intoffset));
+    if (isa<GlobalValue>(val)) {
+      DEBUG_PRINT("Is a global, so true");
+      return true;
+    }
+    bool toReturn = false;
+    DEBUG_PRINT("Checking uses\n");
+    for (Use &use : val->uses()) {
+      Value * useval = use.get();
+      if (auto store = dyn_cast<StoreInst>(useval))
+        toReturn =  toReturn || escapeCheck(store->getPointerOperand());
+      if (auto load = dyn_cast<LoadInst>(useval))
+        toReturn = toReturn || false;
+      if (Instruction* useinst = dyn_cast<Instruction>(useval)) {
+        toReturn = toReturn || isCallSite(useinst);
       }
-      toReturn.insert(make_pair(retPair->first,newList));
+      toReturn = toReturn || escapeCheck(val);
     }
-    DEBUG_PRINT("Done resolving " << *nextPoint << "\n");
-  }
-  DEBUG_PRINT("Done finding BLUs for " << *val << ", found " << toReturn.size() << " values\n");
-#undef UNIFY_OFFSETS
-  return toReturn;
-}
- 
- set<pair<Value*,list<int> > > findBottomLevelValues(Value *val) {
-   visitedBottomLevelValues.clear();
-   return findBottomLevelValues_(val);
- }
- 
- map<pair<Value*,Value*>, AliasResult> pointerAliasDynamic;
- 
- AliasResult pointerAlias(Value *pt1, Value *pt2, Pass *callingpass) {
-  VERBOSE_PRINT("Comparing " << *pt1 << " and " << *pt2 << "\n");
-  //errs() << "Usechainpointeralias is comparing " << *pt1 << " and " << *pt2 << "\n";
-  if (pointerAliasDynamic.count(make_pair(pt1,pt2)) != 0) {
-    VERBOSE_PRINT("Dynamically resolved to  " << pointerAliasDynamic[make_pair(pt1,pt2)] << "\n");
-    //errs() << "Was previously resolved to " << (pointerAliasDynamic[make_pair(pt1,pt2)] ? "aliasing" : "not aliasing") << "\n"; 
-    return pointerAliasDynamic[make_pair(pt1,pt2)];
+    DEBUG_PRINT("Determined to" << (toReturn ? "" : " not") << " escape\n");
+    return toReturn;
   }
 
-  callingPass = callingpass;
-  
-  set<pair<Value*,list<int> > > bottomUsesPt1 = findBottomLevelValues(pt1);
-  set<pair<Value*,list<int> > > bottomUsesPt2 = findBottomLevelValues(pt2);
-
-  //errs() << "pt1 bUses size: " << bottomUsesPt1.size() << "\n";
-  //errs() << "pt2 bUses size: " << bottomUsesPt2.size() << "\n";
-  
-  LIGHT_PRINT(*pt1 << " bottomUserSize " << bottomUsesPt1.size() << "\n");
-  LIGHT_PRINT(*pt2 << " bottomUserSize " << bottomUsesPt2.size() << "\n");
-  
-  AliasResult toReturn = NoAlias;
-
-  for (set<pair<Value*,list<int> > >::iterator pt1pair = bottomUsesPt1.begin(),
-	 end_pt1pair = bottomUsesPt1.end();
-       pt1pair != end_pt1pair && !toReturn; ++pt1pair) {
-    for (set<pair<Value*,list<int> > >::iterator pt2pair = bottomUsesPt2.begin(),
-	   end_pt2pair = bottomUsesPt2.end();
-	 pt2pair != end_pt2pair && !toReturn; ++pt2pair) {
-      if (!pt1pair->first || !pt2pair->first) {
-	//errs() << "At least one of the pointers got a NULL bottomLevelValue\n";
-	LIGHT_PRINT("Skipped BLU comparison due to one of the BLUs having a null source\n");
-	//toReturn = false;
-	continue;
+  BottomLevelValues findBottomLevelValues_(Value *val, SmallPtrSetImpl<Value*> &visitedBottomLevelValues) {
+    DEBUG_PRINT("Finding bottom level values of " << *val << "\n");
+    int pointerSize = module->getDataLayout().getPointerSizeInBits(cast<PointerType>(val->getType())->getAddressSpace());
+    APInt offset = APInt(pointerSize,0);
+    Value* strip = val->stripAndAccumulateInBoundsConstantOffsets(module->getDataLayout(),offset);
+    int intoffset = offset.getLimitedValue();
+    BottomLevelValues toReturn;
+    bool appendOffset = true;
+    SmallPtrSet<Value*,2> nextPointers;
+
+    if (visitedBottomLevelValues.count(val) != 0)
+      return toReturn;
+    visitedBottomLevelValues.insert(val);
+
+    //These are bottom level values, they modify toReturn directly
+    //and do not add pointers to nextPointers
+    if (auto inst = dyn_cast<Instruction>(strip)) {
+      if (isCallSite(inst)) {
+        DEBUG_PRINT("When stripped is callsite " << *inst << "\n");
+        SmallPtrSet<Function*,1> calledFuns = getCalledFuns(inst);
+        for (Function* fun : calledFuns) {
+          //Inline asm case
+          if (!fun) {
+            //Add parameters to nextPointers, scramble current list
+            intoffset = -1;
+            CallSite call(inst);
+            for (auto arg_beg = call.arg_begin();
+                 arg_beg != call.arg_end(); ++arg_beg) {
+              nextPointers.insert(*arg_beg);
+            }
+          }
+          //Assume we know the names of all allocation functions
+          if (fun->getName().equals("malloc") ||
+              fun->getName().equals("MyMalloc")) {
+            if (escapeCheck(strip)) {
+              toReturn[NULL].insert(accessPaths.intern(AccessPath::Offsets(1,intoffset)));
+              DEBUG_PRINT("Which is an escaped allocation: \n");
+            } else {
+              DEBUG_PRINT("Which is not an escaped allocation: \n");
+            }
+          }
+          else {
+            appendOffset=false;
+            //Find the return values of the function
+            for (auto instb = inst_begin(fun);
+                 instb != inst_end(fun); ++instb) {
+              if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
+                if (Value* returnval = returninst->getReturnValue()) {
+                  DEBUG_PRINT("Added " << *(returnval) << " to nextpointers based on " << *inst << " has return " << *returninst << "\n");
+                  nextPointers.insert(returnval);
+                }
+              }
+            }
+          }
+        }
       }
-      LIGHT_PRINT("Comparing BLUs: " << *(pt1pair->first) << " and " << *(pt2pair->first) << "\n");
-      //errs() << "Comparing " << *(pt1pair->first) << " and " << *(pt2pair->first) << "\n";
-      if (pt1pair->first != pt2pair->first) {
-	LIGHT_PRINT("Did not alias, as the source pointers were different\n");
-	continue;
+    }
+    if (auto glob = dyn_cast<GlobalVariable>(strip)) {
+      DEBUG_PRINT("When stripped is global " << *glob << "\n");
+        //errs() << "Stripped value is global\n";
+      //errs() << "Found global: " << *glob << "\n";
+      toReturn[glob].insert(accessPaths.intern(AccessPath::Offsets(1,intoffset)));
+    }
+    if (auto arg = dyn_cast<Argument>(strip)) {
+      DEBUG_PRINT("When stripped is argument " << *arg << "\n");
+      //errs() << "Stripped value is argument\n";
+      //errs() << "Found argument: " << *arg << "\n";
+      for (auto user : arg->getParent()->users()) {
+        if (Instruction *inst = dyn_cast<Instruction>(user)) {
+          if (isCallSite(inst)) {
+            CallSite call(inst);
+            appendOffset = false;
+            DEBUG_PRINT("Added " << *(call.getArgument(arg->getArgNo())) << " to nextpointers based on " << *inst << "\n");
+            nextPointers.insert(call.getArgument(arg->getArgNo()));
+          }
+        }
       }
-      auto pt1b = pt1pair->second.rbegin();
-      auto pt2b = pt2pair->second.rbegin();
-      bool listChecksOut = true;
-      bool strictMatch = true;
-      DEBUG_PRINT("Started comparisons of indexing lists\n");
-      while (pt1b != pt1pair->second.rend() &&
-	     pt2b != pt2pair->second.rend()) {
-	DEBUG_PRINT("Comparing " << *pt1b << " and " << *pt2b << "\n");
-
-	if (*pt1b == -2 || *pt2b == -2) {
-	  DEBUG_PRINT("Atleast one of the indices were dynamic and depends on thread arguments. Optimistically the index lists are then different\n"); 
-	  listChecksOut = false;
-	  break;
-	}
-	
-	if (*pt1b != -1 && *pt2b != -1 && *pt1b != *pt2b) {
-	  DEBUG_PRINT("Indexes were different\n");
-	  listChecksOut = false;
-	  break;
-	}
-	if (*pt1b == -1 || *pt2b == -1) {
-	  DEBUG_PRINT("Atleast one index was dynamic\n");
-	  strictMatch = false;
-	}
-	pt1b++;
-	pt2b++;
+      //toReturn.insert(make_pair((Value*)NULL,list<int>(1,intoffset)));
+    }
+
+    //These are the recursive cases, they add pointers to nextPointers
+    //and define how to merge offsets
+    if (auto load = dyn_cast<LoadInst>(strip)) {
+      DEBUG_PRINT("When stripped is load " << *load << ", added pointer operand to nextpointers\n");
+      nextPointers.insert(load->getPointerOperand());
+    }
+    if (auto dyngep = dyn_cast<GetElementPtrInst>(strip)) {
+      DEBUG_PRINT("When stripped is dynamic gep " << *dyngep << ", added pointer operand to nextpointers\n");
+      nextPointers.insert(dyngep->getPointerOperand());
+      appendOffset = false;
+
+      if (AssumeDependantIndexesDontAlias && gepDependsOnThreadArgument(dyngep)) {
+        DEBUG_PRINT("Determined to vary based on thread arguments\n");
+        intoffset = -2;
+      } else if (AssumeDGEPAliasConstBase) {
+        DEBUG_PRINT("Attempting to resolve dynamic GEP using SCEV\n");
+        if (!handleDynamicGEP(&strip,offset)) {
+          DEBUG_PRINT("Did not manage to resolve dynamic GEP\n");
+          if (!AssumeDGEPNoAlias) {
+            DEBUG_PRINT("Conservatively set offset to dynamic\n");
+            intoffset = -1;
+          } else {
+            DEBUG_PRINT("Optimistically discarded this comparison route\n");
+            nextPointers.erase(dyngep->getPointerOperand());
+          }
+        } else {
+          DEBUG_PRINT("Resolved dynamic GEP to" << offset.getLimitedValue() << "\n");
+          intoffset = offset.getLimitedValue();
+        }
+      } else {
+        if (!AssumeDGEPNoAlias) {
+          DEBUG_PRINT("Conservatively set offset to dynamic\n");
+          intoffset = -1;
+        } else {
+          nextPointers.erase(dyngep->getPointerOperand());
+          DEBUG_PRINT("Optimistically discarded this comparison route\n");
+        }
       }
-      if (pt1b != pt1pair->second.rend() ||
-	  pt2b != pt2pair->second.rend()) {
-	LIGHT_PRINT("BLUs did not alias as their indexing lists were different\n");
-	continue;
+    }
+
+    if (auto phi = dyn_cast<PHINode>(strip)) {
+      DEBUG_PRINT("When stripped is phinode " << *phi << "\n");
+      appendOffset = false;
+      for (Use &use : cast<PHINode>(strip)->incoming_values()) {
+        DEBUG_PRINT("Added " << *(use.get()) << " to nextpointers\n");
+        nextPointers.insert(use.get());
       }
-      if (listChecksOut) {
-	if (!strictMatch) {
-	  LIGHT_PRINT("BLUs may alias\n");
-	  if (toReturn != MustAlias)
-	    toReturn = MayAlias;
-	} else {
-	  LIGHT_PRINT("BlUs must alias\n");
-	  toReturn = MustAlias;
-	}
+    }
+
+#define UNIFY_OFFSETS(X,Y) ((X == -1 || Y == -1) ? -1 : X+Y)
+
+    DEBUG_PRINT("Resolving nextpointers\n");
+
+    for (Value* nextPoint : nextPointers) {
+      DEBUG_PRINT("Resolving " << *nextPoint << "\n");
+      BottomLevelValues hasReturn = findBottomLevelValues_(nextPoint,visitedBottomLevelValues);
+      for (BottomLevelValues::iterator group = hasReturn.begin(),
+             end_group = hasReturn.end(); group != end_group; ++group) {
+        for (const AccessPath *path : group->second) {
+          AccessPath::Offsets newList = path->offsets;
+          if (appendOffset)
+            newList.push_back(intoffset);
+          else {
+            int oldlatest = newList.back();
+            newList.pop_back();
+            newList.push_back(UNIFY_OFFSETS(oldlatest,intoffset));
+          }
+          toReturn[group->first].insert(accessPaths.intern(newList));
+        }
       }
+      DEBUG_PRINT("Done resolving " << *nextPoint << "\n");
     }
+    DEBUG_PRINT("Done finding BLUs for " << *val << ", found " << toReturn.size() << " values\n");
+#undef UNIFY_OFFSETS
+    return toReturn;
   }
-  
-  VERBOSE_PRINT("Determined to " << toReturn << "\n");
-  return pointerAliasDynamic[make_pair(pt1,pt2)]=toReturn;
-}
 
-SmallPtrSet<Value*,1024> visitedAliasValues;
+};
 
 // DEPRECATED
 // //Pointer comparsion
@@ -370,6 +370,11 @@ public:
     }
     //@}
 
+    /// Get points-to with field-insensitive objects expanded, as alias queries compare them
+    inline void getExpandedPts(NodeID id, PointsTo& expandedPts) {
+        expandFIObjs(getPts(id),expandedPts);
+    }
+
 protected:
 
     /// Get points-to data structure
@@ -27,6 +27,8 @@
 #include "MemoryModel/PointerAnalysis.h"
 #include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/Pass.h>
+#include <map>
+#include <vector>
 
 
 /*!
@@ -37,6 +39,9 @@ class WPAPass: public llvm::ModulePass, public llvm::AliasAnalysis {
     typedef std::vector<PointerAnalysis*> PTAVector;
 
 public:
+    /// A pair of values whose alias result is asked in a batch
+    typedef std::pair<const llvm::Value*,const llvm::Value*> ValuePair;
+
     /// Pass ID
     static char ID;
 
@@ -71,6 +76,9 @@ public:
     /// Interface expose to users of our pointer analysis, given Value infos
     virtual llvm::AliasResult alias(const llvm::Value* V1,	const llvm::Value* V2);
 
+    /// Batch interface, the alias result of each pair of values under the rule of alias(V1,V2)
+    void aliasBatch(const std::vector<ValuePair>& queries, std::vector<llvm::AliasResult>& results);
+
     /// We start from here
     virtual bool runOnModule(llvm::Module& module);
 
@@ -83,6 +91,23 @@ private:
     /// Create pointer analysis according to specified kind and analyze the module.
     void runPointerAnalysis(llvm::Module& module, u32_t kind);
 
+    /// Nodes with the same expanded points-to set under one pointer analysis form a class.
+    /// Each class keeps its set once, and each pair of classes is compared once
+    struct PtsClasses {
+        std::map<NodeID,u32_t> classOfNode;
+        std::map<size_t,std::vector<u32_t> > classesOfHash;
+        std::vector<PointsTo> classPts;
+        std::vector<bool> classHasBlackHole;
+        std::map<std::pair<u32_t,u32_t>,bool> classMayAlias;
+    };
+
+    /// Get the class of node under the pointer analysis at index pta
+    u32_t getPtsClass(u32_t pta, NodeID node);
+
+    /// Whether members of two classes may alias under the pointer analysis at index pta
+    bool mayAliasClasses(u32_t pta, u32_t c1, u32_t c2);
+
+    std::vector<PtsClasses> ptsClasses;	///< points-to classes, one per pointer analysis
     PTAVector ptaVector;	///< all pointer analysis to be executed.
     PointerAnalysis* _pta;	///<  pointer analysis to be executed.
 };
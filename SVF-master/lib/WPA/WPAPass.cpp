@@ -25,6 +25,7 @@
 #include "WPA/Andersen.h"
 #include "WPA/FlowSensitive.h"
 #include <llvm/Support/CommandLine.h>
+#include <llvm/ADT/Hashing.h>
 
 using namespace llvm;
 
@@ -155,3 +156,86 @@ llvm::AliasResult WPAPass::alias(const Value* V1, const Value* V2) {
 
     return result;
 }
+
+
+/*!
+ * Get the class of node under the pointer analysis at index pta.
+ * The alias result of two nodes only depends on their expanded points-to sets,
+ * so nodes with equal sets share a class, found by the hash of the set.
+ */
+u32_t WPAPass::getPtsClass(u32_t pta, NodeID node) {
+    PtsClasses& classes = ptsClasses[pta];
+    std::map<NodeID,u32_t>::iterator found = classes.classOfNode.find(node);
+    if (found != classes.classOfNode.end())
+        return found->second;
+
+    /// All analyses run by this pass keep their points-to sets as bitvectors
+    BVDataPTAImpl* bvpta = static_cast<BVDataPTAImpl*>(ptaVector[pta]);
+    PointsTo pts;
+    bvpta->getExpandedPts(node,pts);
+    llvm::hash_code hash = llvm::hash_value(pts.count());
+    for (PointsTo::iterator pit = pts.begin(), epit = pts.end(); pit != epit; ++pit)
+        hash = llvm::hash_combine(hash,*pit);
+
+    std::vector<u32_t>& bucket = classes.classesOfHash[hash];
+    for (std::vector<u32_t>::const_iterator cit = bucket.begin(), ecit = bucket.end(); cit != ecit; ++cit) {
+        if (classes.classPts[*cit] == pts)
+            return classes.classOfNode[node] = *cit;
+    }
+    u32_t cls = classes.classPts.size();
+    bucket.push_back(cls);
+    classes.classHasBlackHole.push_back(bvpta->containBlackHoleNode(pts));
+    classes.classPts.push_back(pts);
+    return classes.classOfNode[node] = cls;
+}
+
+/*!
+ * Whether members of two classes may alias under the pointer analysis at index pta,
+ * as BVDataPTAImpl::alias decides it for two nodes.
+ */
+bool WPAPass::mayAliasClasses(u32_t pta, u32_t c1, u32_t c2) {
+    PtsClasses& classes = ptsClasses[pta];
+    std::pair<u32_t,u32_t> key = c1 < c2 ? std::make_pair(c1,c2) : std::make_pair(c2,c1);
+    std::map<std::pair<u32_t,u32_t>,bool>::iterator found = classes.classMayAlias.find(key);
+    if (found != classes.classMayAlias.end())
+        return found->second;
+    bool mayAlias = classes.classHasBlackHole[c1] || classes.classHasBlackHole[c2] ||
+                    classes.classPts[c1].intersects(classes.classPts[c2]);
+    return classes.classMayAlias[key] = mayAlias;
+}
+
+/*!
+ * Return the alias result of each pair of values, as alias(V1,V2) would.
+ * Each node is expanded once and each pair of points-to classes is compared once,
+ * for this batch and all later ones.
+ */
+void WPAPass::aliasBatch(const std::vector<ValuePair>& queries, std::vector<llvm::AliasResult>& results) {
+    PAG* pag = _pta->getPAG();
+    bool veto = AliasRule.getBits() == 0 || AliasRule.isSet(Veto);
+    bool conservative = !veto && AliasRule.isSet(Conservative);
+    ptsClasses.resize(ptaVector.size());
+
+    results.assign(queries.size(),MayAlias);
+    for (u32_t i = 0; i < queries.size(); i++) {
+        const Value* V1 = queries[i].first;
+        const Value* V2 = queries[i].second;
+        /// Values without a PAG node may alias anything, as in alias(V1,V2)
+        if (!pag->hasValueNode(V1) || !pag->hasValueNode(V2))
+            continue;
+        NodeID n1 = pag->getValueNode(V1);
+        NodeID n2 = pag->getValueNode(V2);
+        if (veto) {
+            /// Return NoAlias if any PTA gives NoAlias result
+            for (u32_t pta = 0; pta < ptaVector.size(); pta++)
+                if (!mayAliasClasses(pta,getPtsClass(pta,n1),getPtsClass(pta,n2)))
+                    results[i] = NoAlias;
+        }
+        else if (conservative) {
+            /// Return MayAlias if any PTA gives MayAlias result
+            results[i] = NoAlias;
+            for (u32_t pta = 0; pta < ptaVector.size(); pta++)
+                if (mayAliasClasses(pta,getPtsClass(pta,n1),getPtsClass(pta,n2)))
+                    results[i] = MayAlias;
+        }
+    }
+}
@@ -0,0 +1,504 @@
+//===---- Dense Instruction Numbering and Bitvector Path Sets -------------===//
+//
+//
+//===----------------------------------------------------------------------===//
+// The paths between synchronization points are sets of loads, stores and
+// calls. Rather than keeping those as pointer sets, every such instruction in
+// the module is given a dense ID and the sets are kept as bitvectors over
+// those IDs
+//===----------------------------------------------------------------------===//
+
+#ifndef _PATHSETHEADER_
+#define _PATHSETHEADER_
+
+#include <vector>
+#include <map>
+#include <set>
+#include <iterator>
+#include <utility>
+#include <mutex>
+#include <cassert>
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace std;
+
+//Assigns each load, store and call of a module a dense ID. IDs are handed
+//out in function, basic block and instruction order. Ignored functions, and
+//direct calls to them, are left out. Those are the annotations other passes
+//insert, so a module keeps its numbering and hash when it is marked. The hash
+//is an MD5 of what decides the numbering and the call targets, so it can be
+//stored and compared in later runs
+class InstructionNumbering {
+public:
+  InstructionNumbering() : moduleHash(0) {}
+
+  //Numbers all loads, stores and calls in M, dropping any earlier numbering
+  void numberModule(Module &M, const set<StringRef> &ignoredFunctions = set<StringRef>()) {
+    clear();
+    MD5 hash;
+    //Initializers decide which functions have their address taken, and so
+    //what indirect calls may call
+    DenseMap<const Value*,unsigned> noLocals;
+    for (GlobalVariable &glob : M.getGlobalList()) {
+      addString(hash,glob.getName());
+      addWord(hash,glob.hasInitializer());
+      if (glob.hasInitializer())
+        addOperand(hash,glob.getInitializer(),noLocals);
+    }
+    for (GlobalAlias &alias : M.getAliasList()) {
+      addString(hash,alias.getName());
+      addOperand(hash,alias.getAliasee(),noLocals);
+    }
+    for (Function &fun : M.getFunctionList()) {
+      if (ignoredFunctions.count(fun.getName()) != 0)
+        continue;
+      addString(hash,fun.getName());
+      addType(hash,fun.getType());
+      addWord(hash,fun.size());
+      //Values local to the function are hashed by their position in it
+      DenseMap<const Value*,unsigned> localIndex;
+      unsigned nextLocal = 0;
+      for (Argument &arg : fun.getArgumentList())
+        localIndex[&arg] = nextLocal++;
+      for (BasicBlock &block : fun) {
+        localIndex[&block] = nextLocal++;
+        for (Instruction &inst : block)
+          if (!callsIgnored(&inst,ignoredFunctions))
+            localIndex[&inst] = nextLocal++;
+      }
+      for (inst_iterator it = inst_begin(&fun); it != inst_end(&fun); ++it) {
+        Instruction *inst = &*it;
+        if (callsIgnored(inst,ignoredFunctions))
+          continue;
+        addWord(hash,inst->getOpcode());
+        addWord(hash,inst->getNumOperands());
+        //Operands, so a changed callee or synchronization variable is seen
+        for (Value *operand : inst->operands())
+          addOperand(hash,operand,localIndex);
+        //Indirect calls may call the functions of a matching type
+        if (isa<CallInst>(inst) || isa<InvokeInst>(inst))
+          addType(hash,CallSite(inst).getCalledValue()->getType());
+        if (isNumbered(inst)) {
+          IDs[inst] = instructions.size();
+          instructions.push_back(inst);
+        }
+      }
+    }
+    MD5::MD5Result digest;
+    hash.final(digest);
+    moduleHash = 0;
+    for (unsigned i = 0; i < 8; ++i)
+      moduleHash |= uint64_t(digest[i]) << (8*i);
+  }
+
+  //The kinds of instructions that are given IDs
+  static bool isNumbered(const Instruction *inst) {
+    return isa<LoadInst>(inst) || isa<StoreInst>(inst) ||
+      isa<CallInst>(inst) || isa<InvokeInst>(inst);
+  }
+
+  bool hasID(Instruction *inst) const {
+    return IDs.count(inst) != 0;
+  }
+
+  unsigned getID(Instruction *inst) const {
+    DenseMap<Instruction*,unsigned>::const_iterator it = IDs.find(inst);
+    assert(it != IDs.end() && "Instruction is not numbered");
+    return it->second;
+  }
+
+  Instruction *getInstruction(unsigned ID) const {
+    assert(ID < instructions.size() && "Instruction ID out of range");
+    return instructions[ID];
+  }
+
+  unsigned size() const {
+    return instructions.size();
+  }
+
+  //Hash of the numbered module, it changes when the IDs could have
+  uint64_t getModuleHash() const {
+    return moduleHash;
+  }
+
+  void clear() {
+    IDs.clear();
+    instructions.clear();
+    moduleHash = 0;
+  }
+
+private:
+  DenseMap<Instruction*,unsigned> IDs;
+  vector<Instruction*> instructions;
+  uint64_t moduleHash;
+
+  //Words are added byte by byte in a fixed order, so the hash is the same
+  //on every host
+  static void addWord(MD5 &hash, uint64_t word) {
+    uint8_t bytes[8];
+    for (unsigned i = 0; i < 8; ++i)
+      bytes[i] = word >> (8*i);
+    hash.update(ArrayRef<uint8_t>(bytes,8));
+  }
+
+  //Strings are length prefixed, so adjacent strings cannot run together
+  static void addString(MD5 &hash, StringRef str) {
+    addWord(hash,str.size());
+    hash.update(str);
+  }
+
+  static void addType(MD5 &hash, Type *type) {
+    string printed;
+    raw_string_ostream out(printed);
+    type->print(out);
+    addString(hash,out.str());
+  }
+
+  static void addOperand(MD5 &hash, const Value *operand, const DenseMap<const Value*,unsigned> &localIndex) {
+    addWord(hash,operand->getValueID());
+    DenseMap<const Value*,unsigned>::const_iterator local = localIndex.find(operand);
+    if (local != localIndex.end()) {
+      addWord(hash,local->second);
+      return;
+    }
+    if (const GlobalValue *global = dyn_cast<GlobalValue>(operand)) {
+      addString(hash,global->getName());
+      return;
+    }
+    if (const ConstantInt *constant = dyn_cast<ConstantInt>(operand)) {
+      const APInt &value = constant->getValue();
+      addWord(hash,value.getBitWidth());
+      for (unsigned i = 0; i < value.getNumWords(); ++i)
+        addWord(hash,value.getRawData()[i]);
+      return;
+    }
+    if (const ConstantDataSequential *data = dyn_cast<ConstantDataSequential>(operand)) {
+      addString(hash,data->getRawDataValues());
+      return;
+    }
+    //Other constants, such as casts of globals, by what they are built from
+    if (const Constant *constant = dyn_cast<Constant>(operand)) {
+      addWord(hash,constant->getNumOperands());
+      for (const Value *part : constant->operands())
+        addOperand(hash,part,localIndex);
+    }
+  }
+
+  static bool callsIgnored(Instruction *inst, const set<StringRef> &ignoredFunctions) {
+    if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+      return false;
+    Function *called = CallSite(inst).getCalledFunction();
+    return called && ignoredFunctions.count(called->getName()) != 0;
+  }
+};
+
+//A set of numbered instructions, kept as a bitvector over the instruction
+//IDs. Iterating it yields the instructions themselves, so it can stand in for
+//a SmallPtrSet<Instruction*,N> in most places. Copies are a copy of the
+//bitvector words and unions are word-wise ORs
+class PathSet {
+public:
+  PathSet() : numbering(NULL) {}
+  explicit PathSet(const InstructionNumbering *numbering) : numbering(numbering) {}
+
+  class iterator : public std::iterator<std::forward_iterator_tag,Instruction*> {
+  public:
+    iterator() : set(NULL), ID(-1) {}
+    iterator(const PathSet *set, int ID) : set(set), ID(ID) {}
+
+    Instruction *operator*() const {
+      return set->numbering->getInstruction(ID);
+    }
+
+    iterator &operator++() {
+      ID = set->bits.find_next(ID);
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator toReturn = *this;
+      ++*this;
+      return toReturn;
+    }
+
+    bool operator==(const iterator &other) const {
+      return ID == other.ID;
+    }
+
+    bool operator!=(const iterator &other) const {
+      return ID != other.ID;
+    }
+
+  private:
+    const PathSet *set;
+    int ID;
+  };
+
+  iterator begin() const {
+    return iterator(this,bits.find_first());
+  }
+
+  iterator end() const {
+    return iterator(this,-1);
+  }
+
+  //Returns true if the instruction was not previously in the set
+  bool insert(Instruction *inst) {
+    assert(numbering && "Inserting into a path set without a numbering");
+    unsigned ID = numbering->getID(inst);
+    if (ID >= bits.size())
+      bits.resize(numbering->size());
+    if (bits.test(ID))
+      return false;
+    bits.set(ID);
+    return true;
+  }
+
+  //Inserts the instructions with IDs in [beginID,endID)
+  void insertRange(unsigned beginID, unsigned endID) {
+    assert(numbering && "Inserting into a path set without a numbering");
+    assert(endID <= numbering->size() && "Instruction ID out of range");
+    if (endID > bits.size())
+      bits.resize(numbering->size());
+    bits.set(beginID,endID);
+  }
+
+  void insert(const PathSet &other) {
+    *this |= other;
+  }
+
+  template <typename IterT>
+  void insert(IterT begin, IterT end) {
+    for (; begin != end; ++begin)
+      insert(*begin);
+  }
+
+  //Returns true if the instruction was in the set
+  bool erase(Instruction *inst) {
+    if (!numbering || !numbering->hasID(inst))
+      return false;
+    unsigned ID = numbering->getID(inst);
+    if (ID >= bits.size() || !bits.test(ID))
+      return false;
+    bits.reset(ID);
+    return true;
+  }
+
+  unsigned count(Instruction *inst) const {
+    if (!numbering || !numbering->hasID(inst))
+      return 0;
+    unsigned ID = numbering->getID(inst);
+    return (ID < bits.size() && bits.test(ID)) ? 1 : 0;
+  }
+
+  unsigned size() const {
+    return bits.count();
+  }
+
+  bool empty() const {
+    return bits.none();
+  }
+
+  //Keeps the allocated words around for reuse
+  void clear() {
+    bits.reset();
+  }
+
+  PathSet &operator|=(const PathSet &other) {
+    if (!numbering)
+      numbering = other.numbering;
+    bits |= other.bits;
+    return *this;
+  }
+
+  //As |=, but returns true if the set grew
+  bool unionWith(const PathSet &other) {
+    unsigned before = bits.count();
+    *this |= other;
+    return bits.count() != before;
+  }
+
+  //Removes the instructions that are in other
+  PathSet &subtract(const PathSet &other) {
+    bits.reset(other.bits);
+    return *this;
+  }
+
+  //Keeps only the instructions that are also in other
+  PathSet &intersect(const PathSet &other) {
+    bits &= other.bits;
+    return *this;
+  }
+
+  bool operator==(const PathSet &other) const {
+    if (bits.size() == other.bits.size())
+      return bits == other.bits;
+    //Sets grown to different sizes can still hold the same instructions
+    int ID = bits.find_first(), otherID = other.bits.find_first();
+    while (ID == otherID && ID != -1) {
+      ID = bits.find_next(ID);
+      otherID = other.bits.find_next(otherID);
+    }
+    return ID == otherID;
+  }
+
+  bool operator!=(const PathSet &other) const {
+    return !(*this == other);
+  }
+
+  const InstructionNumbering *getNumbering() const {
+    return numbering;
+  }
+
+  //Hashes the instructions in the set, independently of its size
+  size_t hash() const {
+    hash_code toReturn = hash_value(0);
+    for (int ID = bits.find_first(); ID != -1; ID = bits.find_next(ID))
+      toReturn = hash_combine(toReturn,ID);
+    return toReturn;
+  }
+
+private:
+  const InstructionNumbering *numbering;
+  BitVector bits;
+};
+
+//An immutable path set interned in a PathSetPool. Equal sets share the same
+//interned copy, so copying a handle or comparing two handles is a pointer
+//operation. A default constructed handle is the empty set
+class SharedPathSet {
+public:
+  typedef PathSet::iterator iterator;
+
+  SharedPathSet() : set(NULL) {}
+
+  iterator begin() const {
+    return get().begin();
+  }
+
+  iterator end() const {
+    return get().end();
+  }
+
+  unsigned count(Instruction *inst) const {
+    return set ? set->count(inst) : 0;
+  }
+
+  unsigned size() const {
+    return set ? set->size() : 0;
+  }
+
+  bool empty() const {
+    return set == NULL;
+  }
+
+  const PathSet &get() const {
+    static const PathSet emptySet;
+    return set ? *set : emptySet;
+  }
+
+  bool operator==(const SharedPathSet &other) const {
+    return set == other.set;
+  }
+
+  bool operator!=(const SharedPathSet &other) const {
+    return set != other.set;
+  }
+
+private:
+  friend class PathSetPool;
+  explicit SharedPathSet(const PathSet *set) : set(set) {}
+  const PathSet *set;
+};
+
+//Owns the interned path sets. Unions of interned sets are cached on the
+//pair of operands, as the same paths are merged into many synch points and
+//regions. The interned sets live as long as the pool
+class PathSetPool {
+public:
+  PathSetPool() {}
+
+  ~PathSetPool() {
+    clear();
+  }
+
+  SharedPathSet intern(const PathSet &set) {
+    lock_guard<mutex> lock(poolMutex);
+    return internLocked(set);
+  }
+
+  SharedPathSet unite(SharedPathSet a, SharedPathSet b) {
+    if (a == b || b.empty())
+      return a;
+    if (a.empty())
+      return b;
+    //Unions commute, so the operands are ordered to share cache entries
+    if (b.set < a.set)
+      std::swap(a,b);
+    lock_guard<mutex> lock(poolMutex);
+    pair<const PathSet*,const PathSet*> key = make_pair(a.set,b.set);
+    auto found = unionCache.find(key);
+    if (found != unionCache.end())
+      return SharedPathSet(found->second);
+    PathSet united = *a.set;
+    united |= *b.set;
+    SharedPathSet toReturn = internLocked(united);
+    unionCache[key] = toReturn.set;
+    return toReturn;
+  }
+
+  //Convenience call
+  SharedPathSet unite(SharedPathSet a, const PathSet &b) {
+    return unite(a,intern(b));
+  }
+
+  //The number of distinct non-empty sets interned
+  unsigned size() const {
+    return internedCount;
+  }
+
+  void clear() {
+    lock_guard<mutex> lock(poolMutex);
+    for (auto &bucket : setsOfHash)
+      for (const PathSet *set : bucket.second)
+        delete set;
+    setsOfHash.clear();
+    unionCache.clear();
+    internedCount = 0;
+  }
+
+private:
+  map<size_t,SmallVector<const PathSet*,1> > setsOfHash;
+  DenseMap<pair<const PathSet*,const PathSet*>,const PathSet*> unionCache;
+  unsigned internedCount = 0;
+  mutex poolMutex;
+
+  SharedPathSet internLocked(const PathSet &set) {
+    if (set.empty())
+      return SharedPathSet();
+    SmallVector<const PathSet*,1> &bucket = setsOfHash[set.hash()];
+    for (const PathSet *interned : bucket)
+      if (*interned == set)
+        return SharedPathSet(interned);
+    bucket.push_back(new PathSet(set));
+    internedCount++;
+    return SharedPathSet(bucket.back());
+  }
+};
+
+#endif
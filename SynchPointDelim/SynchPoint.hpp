@@ -11,10 +11,13 @@
 
 #include <set>
 #include <map>
+#include <atomic>
 
 #include "llvm/IR/Instruction.h"
 #include "llvm/ADT/SmallPtrSet.h"
 
+#include "PathSet.hpp"
+
 using namespace llvm;
 using namespace std;
 
@@ -25,7 +28,7 @@ class CriticalRegion;
 class SynchronizationVariable {
 public:
   SynchronizationVariable() {
-    static int IDCount = 0;
+    static atomic<int> IDCount(0);
     ID = IDCount++;
   }
 
@@ -49,7 +52,7 @@ public:
 class SynchronizationPoint {
 public:
   SynchronizationPoint() {
-    static int IDcount=0;
+    static atomic<int> IDcount(0);
     ID = IDcount++;
   }
 
@@ -80,13 +83,13 @@ public:
   SmallPtrSet<SynchronizationPoint*,2> preceding;
   //For each preceding synchpoint, these are the instructions
   //that can be executed on the path leading here
-  map<SynchronizationPoint*,SmallPtrSet<Instruction*,16> > precedingInsts;
+  map<SynchronizationPoint*,SharedPathSet> precedingInsts;
   //The synchronization points reachable from this without
   //passing over other synch points
   SmallPtrSet<SynchronizationPoint*,2> following;
   //For each following synchpoint, these are the instructions
   //that can be executed on the path leading there
-  map<SynchronizationPoint*,SmallPtrSet<Instruction*,16> > followingInsts;
+  map<SynchronizationPoint*,SharedPathSet> followingInsts;
   //The synchronization variable this is part of (if any)
   SynchronizationVariable *synchVar=NULL;
   //The critical region this is part of (if any)
@@ -132,19 +135,17 @@ public:
   }
 
 
-  SmallPtrSet<Instruction*,128> getPrecedingInsts() {
-    SmallPtrSet<Instruction*,128> toReturn;
+  PathSet getPrecedingInsts() {
+    PathSet toReturn;
     for (SynchronizationPoint* synchPoint : preceding)
-      toReturn.insert(precedingInsts[synchPoint].begin(),
-		      precedingInsts[synchPoint].end());
+      toReturn |= precedingInsts[synchPoint].get();
     return toReturn;
   }
 
-  SmallPtrSet<Instruction*,128> getFollowingInsts() {
-    SmallPtrSet<Instruction*,128> toReturn;
+  PathSet getFollowingInsts() {
+    PathSet toReturn;
     for (SynchronizationPoint* synchPoint : following)
-      toReturn.insert(followingInsts[synchPoint].begin(),
-		      followingInsts[synchPoint].end());
+      toReturn |= followingInsts[synchPoint].get();
     return toReturn;
   }
 
@@ -166,7 +167,7 @@ void SynchronizationVariable::merge(SynchronizationVariable *other) {
 class CriticalRegion {
 public:
   CriticalRegion() {
-    static int IDcount=0;
+    static atomic<int> IDcount(0);
     ID = IDcount++;
   }
 
@@ -214,23 +215,17 @@ public:
     return toReturn;
   }
 
-  SmallPtrSet<Instruction*,128> getPrecedingInsts() {
-    SmallPtrSet<Instruction*,128> toReturn;
-    for (SynchronizationPoint* synchPoint : entrySynchPoints) {
-      SmallPtrSet<Instruction*,128> preceding_ = synchPoint->getPrecedingInsts();
-      toReturn.insert(preceding_.begin(),
-		      preceding_.end());
-    }
+  PathSet getPrecedingInsts() {
+    PathSet toReturn;
+    for (SynchronizationPoint* synchPoint : entrySynchPoints)
+      toReturn |= synchPoint->getPrecedingInsts();
     return toReturn;
   }
 
-  SmallPtrSet<Instruction*,128> getFollowingInsts() {
-    SmallPtrSet<Instruction*,128> toReturn;
-    for (SynchronizationPoint* synchPoint : exitSynchPoints) {
-      SmallPtrSet<Instruction*,128> following_ = synchPoint->getFollowingInsts();
-      toReturn.insert(following_.begin(),
-		      following_.end());
-    }
+  PathSet getFollowingInsts() {
+    PathSet toReturn;
+    for (SynchronizationPoint* synchPoint : exitSynchPoints)
+      toReturn |= synchPoint->getFollowingInsts();
     return toReturn;
   }
 };
@@ -20,7 +20,11 @@
 // #include <list>
 // #include <map>
 #include <utility>
-// #include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -31,6 +35,9 @@
 // #include "llvm/ADT/ArrayRef.h"
 // #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/EquivalenceClasses.h"
 
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
@@ -42,7 +49,7 @@
 #include "llvm/IR/Value.h"
 // #include "llvm/IR/Intrinsics.h"
 // #include "llvm/IR/Metadata.h"
-// #include "llvm/IR/CFG.h"
+#include "llvm/IR/CFG.h"
 // #include "llvm/IR/DerivedTypes.h"
 // #include "llvm/IR/Dominators.h"
 #include "llvm/IR/InstIterator.h"
@@ -63,12 +70,15 @@
 // #include "llvm/Analysis/MemoryLocation.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 // #include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
 
 // #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 // #include "llvm/Transforms/Utils/Cloning.h"
 
 #include "llvm/Pass.h"
 
+#include "../CallTargetIndex/CallTargetIndexPass.cpp"
+#include "PathSet.hpp"
 #include "SynchPoint.hpp"
 //#include "SynchPointDelim.hpp"
 //#include "../PointerAliasing/UseChainAliasing.cpp"
@@ -102,6 +112,14 @@ static cl::opt<bool> cleanPrePost("ccrpp",cl::desc("Do not continue tracking con
 
 static cl::opt<bool> skipUseChainAliasing("nousechain",cl::desc("Do not use the customized \"usechainaliasing\" aliasing algorithm"));
 
+static cl::opt<bool> bottomUpDelimitation("spdbottomup",cl::desc("Delimit functions bottom-up over the SCCs of the call graph rather than on demand from their callers"));
+
+static cl::opt<unsigned> delimitThreads("spdthreads",cl::desc("Delimit independent SCCs of the call graph on this many threads (implies -spdbottomup)"),
+                                        cl::init(1));
+
+static cl::opt<string> resultCache("spdcache",cl::desc("Load the synchronization point graph from this file if it was written for the same module, otherwise compute it and write it there"),
+                                   cl::value_desc("filename"));
+
 static cl::opt<AliasResult> SVALIASLEVEL("svaalevel",cl::desc("The required aliasing level to detect that two synchronization variables are the same"),
                                          cl::init(MayAlias),
                                          cl::values(clEnumVal(NoAlias,"All loads and stores will conflict"),
@@ -193,9 +211,12 @@ namespace {
 
     public:
         virtual void getAnalysisUsage(AnalysisUsage &AU) const{
+            AU.addRequired<CallTargetIndexPass>();
             AU.addRequired<AAResultsWrapperPass>();
             AU.addRequired<AssumptionCacheTracker>();
             AU.addRequired<ThreadDependence>();
+            AU.addRequired<ThreadSharing>();
+            AU.addRequired<AAResultsCache>();
             AU.addRequired<TargetLibraryInfoWrapperPass>();
             AU.addRequired<ScalarEvolutionWrapperPass>();
             AU.addUsedIfAvailable<WPAPass>();
@@ -214,12 +235,12 @@ namespace {
             SmallPtrSet<Function*,4> entrypoints;
 
             wM=&M;
+            //Give every load, store and call an ID for the path sets
+            instNumbering.numberModule(M,noAnalyzeFunctions);
+            callTargets = &getAnalysis<CallTargetIndexPass>().getIndex();
             aacombined = new AliasCombiner(&M,!skipUseChainAliasing,this,SVALIASLEVEL);
             //aacombined->addAliasResult(&aa);
             
-            //Find what functions use synchronizations, this can optimize searching later
-            determineSynchronizedFunctions();
-            
             //Find the "main" function
             Function *main = M.getFunction("main");
             if (!main) {
@@ -232,34 +253,85 @@ namespace {
             //Find other functions to analyze
             findEntryPoints(M,entrypoints);
 
+            //The graph and the regions only depend on the control flow, so
+            //they are loaded when an earlier run on this module saved them
+            if (resultCache.empty() || !readResultCache(resultCache)) {
+                delimitSynchronizationPoints(entrypoints);
+                if (!resultCache.empty())
+                    writeResultCache(resultCache);
+            }
+
+            //Determine what synchronization variables we have
+            determineSynchronizationVariables();
+
+            //Which variables the critical regions synchronize on depends on
+            //the aliasing, so it is filled in afterwards
+            for (CriticalRegion *critRegion : criticalRegions)
+                for (SynchronizationPoint *synchPoint : critRegion->containedSynchPoints)
+                    critRegion->synchsOn.insert(synchPoint->synchVar);
+
+            if (cleanPrePost)
+                cleanCriticalRegionPrePost();
+
+            //Print Synchpointgraph
+            printSynchPointGraph(entrypoints);
+
+            //Print the info
+            printInfo();
+            
+            clearAnalysisHelpStructures();
+
+            return false; //Pure analysis, should not change any code
+        }
+
+        //These data structures are the results of the analysis
+        SmallPtrSet<SynchronizationPoint*,32> synchronizationPoints;
+        SmallPtrSet<SynchronizationVariable*,8> synchronizationVariables;
+        SmallPtrSet<CriticalRegion*,8> criticalRegions;
+        //The numbering the path sets of the synchronization points refer to
+        InstructionNumbering instNumbering;
+        //Interns the path sets of the synchronization points, so identical
+        //paths are stored once
+        PathSetPool pathSetPool;
+
+        // SynchPointResults getResults() {
+        //     SynchPointResults results;
+        //     results.synchronizationPoints=synchronizationPoints;
+        //     results.synchronizationVariables=synchronizationVariables;
+        //     results.criticalRegions=criticalRegions;
+        //     return results;
+        // }
+
+    private:
+
+        //Finds the synchronization points reachable from the entry points
+        //and the paths between them, cleans them up and sections them into
+        //critical regions
+        void delimitSynchronizationPoints(SmallPtrSet<Function*,4> &entrypoints) {
+            Function *main = wM->getFunction("main");
+
+            //Find what functions use synchronizations, this can optimize searching later
+            determineSynchronizedFunctions();
+
+            //Compute the function summaries bottom-up, delimiting the entry
+            //points below then only splices them
+            if (bottomUpDelimitation || delimitThreads > 1)
+                delimitCallGraphBottomUp(entrypoints);
+
             //Analyze each entry point
             for (Function *target : entrypoints) {
                 VERBOSE_PRINT("Starting an analysis from fun: " << target->getName() << "...\n");
                 //Start a delimitation of each targeted function with a dummy state,
                 //starting from a NULL synch point
-                vector<State> endingPoints;
                 delimitFunction(target);
                 for (State state : delimitFunctionDynamic[target].trailingStates) {
                     updateSynchPointWithState(state,NULL);
                 }
-                
-                SmallPtrSet<State*,4> toDelete;
-                for (pair<BasicBlock* const,SmallPtrSet<State*,2> > &bb : visitedBlocks) {
-                    for (State* state : bb.second)
-                        toDelete.insert(state);
-                }
-                for (State *state : toDelete)
-                    delete state;
-                visitedBlocks.clear();
             }
 
-
-            //Determine what synchronization variables we have
-            determineSynchronizationVariables();
-
             //Color the synch points reachable from any thread entry point
             for (Function *target : entrypoints) {
-                if (target!=M.getFunction("main"))
+                if (target!=main)
                     for (State funState : delimitFunctionDynamic[target].leadingReverseStates) {
                         colorSynchPoints(funState.lastSynch);
                     }
@@ -283,57 +355,365 @@ namespace {
 
             //Clean up the sets specifically leading to the starts in main
             for (State funState : delimitFunctionDynamic[main].leadingReverseStates) {
-                funState.lastSynch->precedingInsts[NULL].clear();
+                funState.lastSynch->precedingInsts[NULL] = SharedPathSet();
             }
+
+            //The first synch points of the entry points
+            for (Function *target : entrypoints)
+                for (State funState : delimitFunctionDynamic[target].leadingReverseStates)
+                    if (funState.lastSynch)
+                        entrySynchs[target].push_back(funState.lastSynch);
             
             //Determine the critical regions we have
             determineCriticalRegions(entrypoints);
 
-            //Print Synchpointgraph
-            printSynchPointGraph(entrypoints);
+            renumberSynchPoints();
+        }
 
-            //Print the info
-            printInfo();
-            
-            clearAnalysisHelpStructures();
+        //Synch points are created in whatever order the delimitation, or its
+        //workers, got to them. They are renumbered in program order so every
+        //mode gives the same IDs
+        void renumberSynchPoints() {
+            vector<SynchronizationPoint*> created(synchronizationPoints.begin(),
+                                                  synchronizationPoints.end());
+            sort(created.begin(),created.end(),
+                 [this](SynchronizationPoint *a, SynchronizationPoint *b) {
+                     return instNumbering.getID(a->val) < instNumbering.getID(b->val);
+                 });
+            for (unsigned i = 0; i < created.size(); ++i)
+                created[i]->ID = i;
+        }
 
-            return false; //Pure analysis, should not change any code
+        //The result cache is a binary file of 32 bit words. Synch points and
+        //regions are referred to by their position in the file and
+        //instructions by their ID in the numbering, so it can only be read
+        //back for a module with the same hash
+        static const uint32_t resultCacheMagic = 0x58535044;
+        static const uint32_t resultCacheVersion = 3;
+        static const uint32_t noPoint = ~0u;
+
+        //The options that change the graph that is delimited, a cache written
+        //with other options is not used
+        static uint32_t getDelimitationOptions() {
+            return (bottomUpDelimitation || delimitThreads > 1) ? 1 : 0;
         }
 
-        //These data structures are the results of the analysis
-        SmallPtrSet<SynchronizationPoint*,32> synchronizationPoints;
-        SmallPtrSet<SynchronizationVariable*,8> synchronizationVariables;
-        SmallPtrSet<CriticalRegion*,8> criticalRegions;
+        static void writeWord(ofstream &out, uint32_t word) {
+            out.write(reinterpret_cast<const char*>(&word),sizeof(word));
+        }
 
-        // SynchPointResults getResults() {
-        //     SynchPointResults results;
-        //     results.synchronizationPoints=synchronizationPoints;
-        //     results.synchronizationVariables=synchronizationVariables;
-        //     results.criticalRegions=criticalRegions;
-        //     return results;
-        // }
+        static uint32_t readWord(ifstream &in) {
+            uint32_t word = 0;
+            in.read(reinterpret_cast<char*>(&word),sizeof(word));
+            return word;
+        }
 
-    private:
+        //Writes the synch point graph, the path sets and the critical
+        //regions to fileName
+        void writeResultCache(const string &fileName) {
+            ofstream out(fileName.c_str(),ios::out | ios::binary | ios::trunc);
+            if (!out.is_open()) {
+                VERBOSE_PRINT("Failed to write the result cache to " << fileName << "\n");
+                return;
+            }
+            //Synch points in the order they were created
+            vector<SynchronizationPoint*> points(synchronizationPoints.begin(),synchronizationPoints.end());
+            sort(points.begin(),points.end(),
+                 [](SynchronizationPoint *a, SynchronizationPoint *b) {
+                     return a->ID < b->ID;
+                 });
+            map<SynchronizationPoint*,uint32_t> pointIndex;
+            pointIndex[NULL] = noPoint;
+            for (unsigned i = 0; i < points.size(); ++i)
+                pointIndex[points[i]] = i;
+            //Each interned path set is written once
+            vector<const PathSet*> pathSets;
+            map<const PathSet*,uint32_t> pathSetIndex;
+            auto indexOf = [&](const SharedPathSet &set) -> uint32_t {
+                if (set.empty())
+                    return noPoint;
+                const PathSet *pathSet = &set.get();
+                if (pathSetIndex.count(pathSet) == 0) {
+                    pathSetIndex[pathSet] = pathSets.size();
+                    pathSets.push_back(pathSet);
+                }
+                return pathSetIndex[pathSet];
+            };
+            for (SynchronizationPoint *synchPoint : points) {
+                for (SynchronizationPoint *pred : synchPoint->preceding)
+                    indexOf(synchPoint->precedingInsts[pred]);
+                for (SynchronizationPoint *follow : synchPoint->following)
+                    indexOf(synchPoint->followingInsts[follow]);
+            }
+
+            writeWord(out,resultCacheMagic);
+            writeWord(out,resultCacheVersion);
+            writeWord(out,getDelimitationOptions());
+            writeWord(out,instNumbering.getModuleHash());
+            writeWord(out,instNumbering.getModuleHash() >> 32);
+            writeWord(out,instNumbering.size());
+
+            //Path sets are written as runs of consecutive IDs, as most of
+            //them are whole blocks of loads and stores
+            writeWord(out,pathSets.size());
+            for (const PathSet *pathSet : pathSets) {
+                vector<pair<uint32_t,uint32_t> > runs;
+                for (Instruction *inst : *pathSet) {
+                    uint32_t ID = instNumbering.getID(inst);
+                    if (!runs.empty() && runs.back().second == ID)
+                        runs.back().second++;
+                    else
+                        runs.push_back(make_pair(ID,ID+1));
+                }
+                writeWord(out,runs.size());
+                for (pair<uint32_t,uint32_t> run : runs) {
+                    writeWord(out,run.first);
+                    writeWord(out,run.second);
+                }
+            }
+
+            writeWord(out,points.size());
+            for (SynchronizationPoint *synchPoint : points) {
+                writeWord(out,instNumbering.getID(synchPoint->val));
+                writeWord(out,synchPoint->isCritBegin | synchPoint->isCritEnd << 1 |
+                          synchPoint->isOnewayFrom << 2 | synchPoint->isOnewayTo << 3);
+                writeWord(out,synchPoint->op);
+            }
+            for (SynchronizationPoint *synchPoint : points) {
+                writeWord(out,synchPoint->preceding.size());
+                for (SynchronizationPoint *pred : synchPoint->preceding) {
+                    writeWord(out,pointIndex[pred]);
+                    writeWord(out,indexOf(synchPoint->precedingInsts[pred]));
+                }
+                writeWord(out,synchPoint->following.size());
+                for (SynchronizationPoint *follow : synchPoint->following) {
+                    writeWord(out,pointIndex[follow]);
+                    writeWord(out,indexOf(synchPoint->followingInsts[follow]));
+                }
+            }
+
+            writeWord(out,entrySynchs.size());
+            for (pair<Function* const,vector<SynchronizationPoint*> > &entry : entrySynchs) {
+                writeWord(out,entry.first->getName().size());
+                out.write(entry.first->getName().data(),entry.first->getName().size());
+                writeWord(out,entry.second.size());
+                for (SynchronizationPoint *synchPoint : entry.second)
+                    writeWord(out,pointIndex[synchPoint]);
+            }
+
+            vector<CriticalRegion*> regions(criticalRegions.begin(),criticalRegions.end());
+            sort(regions.begin(),regions.end(),
+                 [](CriticalRegion *a, CriticalRegion *b) {
+                     return a->ID < b->ID;
+                 });
+            map<CriticalRegion*,uint32_t> regionIndex;
+            regionIndex[NULL] = noPoint;
+            for (unsigned i = 0; i < regions.size(); ++i)
+                regionIndex[regions[i]] = i;
+            auto writePoints = [&](SmallPtrSetImpl<SynchronizationPoint*> &set) {
+                writeWord(out,set.size());
+                for (SynchronizationPoint *synchPoint : set)
+                    writeWord(out,pointIndex[synchPoint]);
+            };
+            writeWord(out,regions.size());
+            for (CriticalRegion *critRegion : regions) {
+                writeWord(out,critRegion->firstRegionInEntry);
+                writePoints(critRegion->containedSynchPoints);
+                writePoints(critRegion->entrySynchPoints);
+                writePoints(critRegion->exitSynchPoints);
+            }
+            for (SynchronizationPoint *synchPoint : points)
+                writeWord(out,regionIndex[synchPoint->critRegion]);
+            out.close();
+        }
+
+        //Rebuilds the synch point graph, the path sets and the critical
+        //regions from fileName. Returns false, leaving the results empty, if
+        //the file is missing or was written for another module
+        bool readResultCache(const string &fileName) {
+            ifstream in(fileName.c_str(),ios::in | ios::binary | ios::ate);
+            if (!in.is_open())
+                return false;
+            uint64_t fileSize = in.tellg();
+            in.seekg(0);
+            if (readWord(in) != resultCacheMagic || readWord(in) != resultCacheVersion || !in.good())
+                return false;
+            if (readWord(in) != getDelimitationOptions()) {
+                VERBOSE_PRINT("Result cache " << fileName << " was written with other options\n");
+                return false;
+            }
+            uint64_t hash = readWord(in);
+            hash |= uint64_t(readWord(in)) << 32;
+            if (hash != instNumbering.getModuleHash() || readWord(in) != instNumbering.size()) {
+                VERBOSE_PRINT("Result cache " << fileName << " is for another module\n");
+                return false;
+            }
+            VERBOSE_PRINT("Loading the synchronization point graph from " << fileName << "\n");
+
+            //IDs and indices are checked against what they index, so a
+            //truncated file is rejected rather than read out of bounds
+            bool valid = true;
+            auto readIndex = [&](uint32_t bound) -> uint32_t {
+                uint32_t index = readWord(in);
+                if (!in.good() || (index != noPoint && index >= bound))
+                    valid = false;
+                return valid ? index : noPoint;
+            };
+            //Counts are checked against what is left of the file before
+            //anything is allocated for them, wordsEach being the fewest words
+            //each counted entry takes
+            auto readCount = [&](uint64_t wordsEach) -> uint32_t {
+                uint32_t count = readWord(in);
+                uint64_t left = in.good() ? (fileSize - uint64_t(in.tellg())) / sizeof(uint32_t) : 0;
+                if (!in.good() || count * wordsEach > left)
+                    valid = false;
+                return valid ? count : 0;
+            };
+
+            vector<SharedPathSet> pathSets(readCount(1));
+            for (unsigned i = 0; valid && i < pathSets.size(); ++i) {
+                PathSet pathSet(&instNumbering);
+                uint32_t runs = readWord(in);
+                for (unsigned j = 0; valid && j < runs; ++j) {
+                    uint32_t begin = readIndex(instNumbering.size());
+                    uint32_t end = readIndex(instNumbering.size() + 1);
+                    if (valid && begin < end)
+                        pathSet.insertRange(begin,end);
+                }
+                pathSets[i] = pathSetPool.intern(pathSet);
+            }
+            auto pathSetAt = [&](uint32_t index) -> SharedPathSet {
+                return index == noPoint ? SharedPathSet() : pathSets[index];
+            };
+
+            vector<SynchronizationPoint*> points(valid ? readCount(3) : 0);
+            for (unsigned i = 0; valid && i < points.size(); ++i) {
+                uint32_t ID = readIndex(instNumbering.size());
+                uint32_t flags = readWord(in);
+                int op = readWord(in);
+                if (!valid || ID == noPoint) {
+                    valid = false;
+                    break;
+                }
+                //Points are written in the order of their IDs
+                SynchronizationPoint *synchPoint = new SynchronizationPoint;
+                synchPoint->ID = i;
+                synchPoint->val = instNumbering.getInstruction(ID);
+                synchPoint->isCritBegin = flags & 1;
+                synchPoint->isCritEnd = flags & 2;
+                synchPoint->isOnewayFrom = flags & 4;
+                synchPoint->isOnewayTo = flags & 8;
+                synchPoint->op = op;
+                points[i] = synchPoint;
+                synchronizationPoints.insert(synchPoint);
+            }
+            auto pointAt = [&](uint32_t index) -> SynchronizationPoint* {
+                return index == noPoint ? NULL : points[index];
+            };
+            for (unsigned i = 0; valid && i < points.size(); ++i) {
+                uint32_t preceding = readWord(in);
+                for (unsigned j = 0; valid && j < preceding; ++j) {
+                    SynchronizationPoint *pred = pointAt(readIndex(points.size()));
+                    SharedPathSet insts = pathSetAt(readIndex(pathSets.size()));
+                    points[i]->preceding.insert(pred);
+                    points[i]->precedingInsts[pred] = insts;
+                }
+                uint32_t following = readWord(in);
+                for (unsigned j = 0; valid && j < following; ++j) {
+                    SynchronizationPoint *follow = pointAt(readIndex(points.size()));
+                    SharedPathSet insts = pathSetAt(readIndex(pathSets.size()));
+                    points[i]->following.insert(follow);
+                    points[i]->followingInsts[follow] = insts;
+                }
+            }
+
+            uint32_t entries = valid ? readCount(2) : 0;
+            for (unsigned i = 0; valid && i < entries; ++i) {
+                uint32_t nameSize = readCount(0);
+                if (!valid || nameSize > fileSize - uint64_t(in.tellg())) {
+                    valid = false;
+                    break;
+                }
+                string name(nameSize,'\0');
+                in.read(&name[0],name.size());
+                Function *fun = wM->getFunction(name);
+                if (!fun || !in.good()) {
+                    valid = false;
+                    break;
+                }
+                uint32_t synchs = readWord(in);
+                for (unsigned j = 0; valid && j < synchs; ++j)
+                    if (SynchronizationPoint *synchPoint = pointAt(readIndex(points.size())))
+                        entrySynchs[fun].push_back(synchPoint);
+            }
+
+            vector<CriticalRegion*> regions(valid ? readCount(4) : 0);
+            auto readPoints = [&](SmallPtrSetImpl<SynchronizationPoint*> &set) {
+                uint32_t size = readWord(in);
+                for (unsigned j = 0; valid && j < size; ++j)
+                    set.insert(pointAt(readIndex(points.size())));
+            };
+            for (unsigned i = 0; valid && i < regions.size(); ++i) {
+                CriticalRegion *critRegion = new CriticalRegion;
+                critRegion->firstRegionInEntry = readWord(in);
+                readPoints(critRegion->containedSynchPoints);
+                readPoints(critRegion->entrySynchPoints);
+                readPoints(critRegion->exitSynchPoints);
+                regions[i] = critRegion;
+                criticalRegions.insert(critRegion);
+            }
+            for (unsigned i = 0; valid && i < points.size(); ++i) {
+                uint32_t region = readIndex(regions.size());
+                points[i]->critRegion = region == noPoint ? NULL : regions[region];
+            }
+
+            if (!valid) {
+                VERBOSE_PRINT("Result cache " << fileName << " is truncated, recomputing\n");
+                for (SynchronizationPoint *synchPoint : synchronizationPoints)
+                    delete synchPoint;
+                for (CriticalRegion *critRegion : criticalRegions)
+                    delete critRegion;
+                synchronizationPoints.clear();
+                criticalRegions.clear();
+                entrySynchs.clear();
+                pathSetPool.clear();
+                return false;
+            }
+            return true;
+        }
 
         void clearAnalysisHelpStructures() {
             delimitFunctionDynamic.clear();
             synchronizedFunctions.clear();
             getExecutableInstsDynamic.clear();
+            executableCalleesDynamic.clear();
+            synchPointOfInst.clear();
+            delimitCalleesDynamic.clear();
+            recursiveSCCOf.clear();
+            entrySynchs.clear();
             delete aacombined;
         }
 
         AliasCombiner *aacombined;
 
+        //Shared index of what each call site may call
+        CallTargetIndex *callTargets;
+
+        //The synch points first reached from each entry point
+        map<Function*,vector<SynchronizationPoint*> > entrySynchs;
+
         Function *DummyATOMICASMFunc;
         
-        //The state tracks the DFS of the program flow
+        //The state tracks the program flow
         //Contains the most recent synch point tracked on this path
         //Contains the instructions executable since passing that
         //synch point
         class State {
         public:
+            State(const InstructionNumbering *numbering=NULL) :
+                lastSynch(NULL), precedingInstructions(numbering) {}
             SynchronizationPoint* lastSynch;
-            SmallPtrSet<Instruction*,32> precedingInstructions;
+            PathSet precedingInstructions;
         };
 
         class FunctionAnalysisState {
@@ -342,594 +722,536 @@ namespace {
             AnalysisState astate = BeingAnalyzed;
             vector<State> trailingStates;
             vector<State> leadingReverseStates;
-            SmallPtrSet<SynchronizationPoint*,1> recursiveDummySyncs;
         };
 
         //Maps functions to their analysis state
         map<Function*,FunctionAnalysisState> delimitFunctionDynamic; 
 
-        //Delimits synchronization points for a particular function
-        //Input: Function to analyze and the states to track before analysing,
-        // also the set of function calls that should not be analyzed
-        //Returns: A set of set of states, one state for each exit point
-        //and each path to reach that exit point
-        //Side-effects: Updates all the synchronization points within the
-        //function correctly
-        void delimitFunction(Function *start) {//,vector<State> states) {
-            set<CallSite> noRecurseSet;
-            //return delimitFunction(start,states,noRecurseSet,CallSite());
-            delimitFunction(start,noRecurseSet,CallSite());
+        //Utility: Looks up the analysis state of a function without inserting
+        //into the map, so workers may use it while delimiting in parallel
+        FunctionAnalysisState &getAnalysisState(Function *fun) {
+            map<Function*,FunctionAnalysisState>::iterator it = delimitFunctionDynamic.find(fun);
+            assert(it != delimitFunctionDynamic.end() && "Function has no analysis state");
+            return it->second;
         }
 
-        void delimitFunction(Function *start, set<CallSite> &noRecurseSet, CallSite callInst) {
+        //Delimits synchronization points for a particular function
+        //Input: Function to analyze
+        //Side-effects: Sets up the leadingReverseStates and trailingStates
+        //of the function, and updates all the synchronization points within
+        //the function correctly
+        void delimitFunction(Function *start) {
             LIGHT_PRINT("Starting analysis of function: " << start->getName() << "\n");
-            if (isNotNull(callInst))
-                DEBUG_PRINT("From function call: " << *(callInst.getInstruction()) << "\n");
             //Check if we have handled this function previously, if so. Do nothing
-            if (delimitFunctionDynamic.count(start) != 0 &&
-                delimitFunctionDynamic[start].astate == FunctionAnalysisState::Analyzed) {
+            if (delimitFunctionDynamic.count(start) != 0) {
+                assert(getAnalysisState(start).astate == FunctionAnalysisState::Analyzed &&
+                       "Recursive call outside of a recursive SCC");
                 DEBUG_PRINT("Previously handled - dynamic resolution\n");
-            } else {
-                bool isOriginalCall=true;
-                if (delimitFunctionDynamic.count(start) != 0 && delimitFunctionDynamic[start].astate == FunctionAnalysisState::BeingAnalyzed) {
-                    DEBUG_PRINT("Encountered recursion - added to no-recurse set\n");
-                    if (isNotNull(callInst))
-                        noRecurseSet.insert(callInst);
-                    isOriginalCall=false;
-                }
-                                
-                //Start analysis of the function
-                FunctionAnalysisState funState;
-                funState.astate = FunctionAnalysisState::BeingAnalyzed;
-                if (delimitFunctionDynamic.count(start) == 0) {
-                    delimitFunctionDynamic[start]=funState;
-                }
-                State dummyState;
-                dummyState.lastSynch = NULL;
-                vector<State> trailStates;
-                
-                //Analyze CFG of function if it might synchronize
-                if (synchronizedFunctions.count(start) != 0) {
-                    //if (true) {
-                    vector<State> dummyVector;
-                    dummyVector.push_back(dummyState);
-                    //VERBOSE_PRINT("Analyzing the CFG of " << start->getName() << "...\n");
-                    trailStates = delimitFromBlock(&(start->getEntryBlock()),dummyVector,
-                                                   start,
-                                                   noRecurseSet);
-                    //VERBOSE_PRINT("Done analyzing the CFG of " << start->getName() << "\n");
-                }
-                //Otherwise, just add all the instructions executable within it or functions it calls
-                else {
-                    DEBUG_PRINT("Resolved as non-synchronized function\n");
-                    SmallPtrSet<Instruction*,128> returned = getExecutableInsts(start);
-                    dummyState.precedingInstructions.insert(returned.begin(),returned.end());
-                    trailStates.push_back(dummyState);
-                }
-                if (isOriginalCall==true) {
-                    LIGHT_PRINT("Original analysis call is done\n");
-                    delimitFunctionDynamic[start].astate = FunctionAnalysisState::Analyzed;
-                    delimitFunctionDynamic[start].leadingReverseStates=unifyRedundantStates(delimitFunctionDynamic[start].leadingReverseStates);
-                    LIGHT_PRINT("Clearing out the shortcut data structures\n");
-                    //Clean out the tracked basicblocks from the visited and shortcircuited sets
-                    SmallPtrSet<State*,4> toDelete;
-                    for (Function::iterator block_it = start->begin(); block_it != start->end(); ++block_it) {
-                        BasicBlock* block = &*block_it;
-                        if (visitedBlocks.count(block) != 0) {
-                            for (State *ptr : visitedBlocks[block])
-                                toDelete.insert(ptr);
-                            visitedBlocks.erase(block);
-                        }
-                        speccCaseBackedgeBlocks.erase(block);
-                    }
-                    for (State *state : toDelete)
-                        delete state;
-
-                    delimitFunctionDynamic[start].trailingStates.insert(delimitFunctionDynamic[start].trailingStates.end(),
-                                                                        trailStates.begin(),
-                                                                        trailStates.end());
-                    delimitFunctionDynamic[start].trailingStates=unifyRedundantStates(delimitFunctionDynamic[start].trailingStates);
-
-                    //Handle the left-over recursive states, if any
-                    LIGHT_PRINT("Handling recursive dummy syncs, if any\n");
-
-                    for (SynchronizationPoint *dummy : delimitFunctionDynamic[start].recursiveDummySyncs) {
-                        for (pair<Function* const, FunctionAnalysisState> & funstatepair : delimitFunctionDynamic) {
-                            FunctionAnalysisState &funstate=funstatepair.second;
-                            for (vector<State>::iterator it = funstate.trailingStates.begin();
-                                 it != funstate.trailingStates.end();) {
-                                if (it->lastSynch == dummy)
-                                    it=funstate.trailingStates.erase(it);
-                                else
-                                    it++;
-                            }
-                        }
-
-                        for (SynchronizationPoint* toPoint : dummy->following) {
-                            if (toPoint) {
-                                State newState;
-                                //Update so that the trailing states have as followers the states found from the
-                                //dumy, and vice-verse
-                                for (State state : delimitFunctionDynamic[start].trailingStates) {
-                                    state.precedingInstructions.insert(dummy->followingInsts[toPoint].begin(),
-                                                                       dummy->followingInsts[toPoint].end());
-                                    updateSynchPointWithState(state,toPoint);
-                                }
-                                //Update so that the following states of the dummy no long have the dummy as preceding
-                                toPoint->preceding.erase(dummy);
-                                toPoint->precedingInsts.erase(dummy);
-                            }
-                        }
-                    }
-                    for (SynchronizationPoint *dummy : delimitFunctionDynamic[start].recursiveDummySyncs) {
-                        delete dummy;
-                    }
-                    delimitFunctionDynamic[start].recursiveDummySyncs.clear();
+                return;
+            }
+            //A recursive function is delimited together with the functions it
+            //recurses through, until their summaries stop growing
+            vector<Function*> &scc = getRecursiveSCC(start);
+            if (!scc.empty()) {
+                for (Function *fun : scc)
+                    delimitFunctionDynamic[fun]=FunctionAnalysisState();
+                delimitSCC(scc);
+                return;
+            }
 
-                    LIGHT_PRINT("Done.\n");
-                } else {
-                    LIGHT_PRINT("Setting up dummy state for recursive call\n");
-                    SynchronizationPoint * dummySync = new SynchronizationPoint;
-                    State newState;
-                    newState.lastSynch=dummySync;
-                    delimitFunctionDynamic[start].recursiveDummySyncs.insert(dummySync);
-                    delimitFunctionDynamic[start].trailingStates.push_back(newState);
-                }
+            //Start analysis of the function
+            delimitFunctionDynamic[start]=FunctionAnalysisState();
+            summarizeFunction(start);
+        }
 
-                //TODO: This is a bit too general, the real assert should check that if there are no trailstates (function returns only by unreachable) then the function must be a function
-                //that is either main or a thread entry point
-                //assert(!(delimitFunctionDynamic[start].trailingStates.size() == 0 && start != wM->getFunction("main")) && "Empty trailing states in function that has finished analysis that is not main.");
+        //Sets up the leadingReverseStates and trailingStates of a function
+        //that has an analysis state but is not yet analyzed
+        void summarizeFunction(Function *start) {
+            FunctionAnalysisState &funState = getAnalysisState(start);
+            vector<State> trailStates;
+            
+            //Analyze CFG of function if it might synchronize
+            if (synchronizedFunctions.count(start) != 0) {
+                trailStates = delimitFunctionBody(start);
             }
+            //Otherwise, just add all the instructions executable within it or functions it calls
+            else {
+                DEBUG_PRINT("Resolved as non-synchronized function\n");
+                State dummyState(&instNumbering);
+                dummyState.precedingInstructions |= getExecutableInsts(start);
+                trailStates.push_back(dummyState);
+            }
+
+            LIGHT_PRINT("Original analysis call is done\n");
+            funState.astate = FunctionAnalysisState::Analyzed;
+            funState.leadingReverseStates=unifyRedundantStates(funState.leadingReverseStates);
+
+            funState.trailingStates.insert(funState.trailingStates.end(),
+                                           trailStates.begin(),
+                                           trailStates.end());
+            funState.trailingStates=unifyRedundantStates(funState.trailingStates);
+
+            //TODO: This is a bit too general, the real assert should check that if there are no trailstates (function returns only by unreachable) then the function must be a function
+            //that is either main or a thread entry point
+            //assert(!(delimitFunctionDynamic[start].trailingStates.size() == 0 && start != wM->getFunction("main")) && "Empty trailing states in function that has finished analysis that is not main.");
             DEBUG_PRINT("Done analyzing " << start->getName() << "\n");
         }
 
-#define HASMORETHANONEPRED(ptr) (ptr->getUniquePredecessor() == NULL && pred_begin(ptr) != pred_end(ptr))
-
-        vector<State> delimitFromBlock(BasicBlock *curr,vector<State> states,
-                                       //vector<State> *firstReachable,
-                                       Function *addFirstToFun,
-                                       set<CallSite> &noRecurseSet) {
-            map<BasicBlock*,SmallPtrSet<Instruction*,64> > dummy1;
-            map<BasicBlock*,SmallPtrSet<BasicBlock*,64> > dummy2;
-            return delimitFromBlock(curr,states,addFirstToFun,noRecurseSet,
-                                    SmallPtrSet<BasicBlock*,64>(),
-                                    dummy1,dummy2);
+        //The states reaching a point in a function, keyed on the most recent
+        //synch point (NULL being the entry of the function)
+        typedef map<SynchronizationPoint*,PathSet> StateMap;
+
+        //Delimits the synchronization points of a function body
+        //The CFG is handled as a dataflow problem over the basic blocks rather
+        //than as a DFS. The SCCs of the CFG are visited in topological order, the
+        //blocks of each SCC in reverse post-order, and an SCC with a loop is
+        //revisited until the states at its blocks no longer change
+        //Returns: The states reaching the exits of the function
+        //Side-effects: Updates the synchronization points with the paths within
+        //the function, and the leadingReverseStates of the function
+        vector<State> delimitFunctionBody(Function *fun) {
+            //The SCC iterator gives the SCCs bottom-up, we want them top-down
+            vector<vector<BasicBlock*> > blockSCCs;
+            for (scc_iterator<Function*> scc = scc_begin(fun); !scc.isAtEnd(); ++scc)
+                blockSCCs.push_back(*scc);
+            reverse(blockSCCs.begin(),blockSCCs.end());
+
+            map<BasicBlock*,unsigned> rpoIndex;
+            unsigned nextIndex = 0;
+            ReversePostOrderTraversal<Function*> rpot(fun);
+            for (BasicBlock *block : rpot)
+                rpoIndex[block] = nextIndex++;
+
+            map<BasicBlock*,StateMap> blockStates;
+            StateMap exitStates;
+            blockStates[&(fun->getEntryBlock())][NULL] = PathSet(&instNumbering);
+
+            for (vector<BasicBlock*> &blockSCC : blockSCCs) {
+                sort(blockSCC.begin(),blockSCC.end(),
+                     [&rpoIndex](BasicBlock *a, BasicBlock *b) {
+                         return rpoIndex[a] < rpoIndex[b];
+                     });
+                SmallPtrSet<BasicBlock*,8> inSCC(blockSCC.begin(),blockSCC.end());
+                SmallPtrSet<BasicBlock*,8> dirty(blockSCC.begin(),blockSCC.end());
+                while (!dirty.empty()) {
+                    for (BasicBlock *block : blockSCC) {
+                        if (!dirty.erase(block))
+                            continue;
+                        LIGHT_PRINT("Handling BasicBlock: " << block->getName() << "\n");
+                        StateMap states = blockStates[block];
+                        delimitBlock(block,states,fun);
+                        if (succ_begin(block) == succ_end(block)) {
+                            mergeStates(exitStates,states);
+                            continue;
+                        }
+                        for (succ_iterator succ = succ_begin(block), succe = succ_end(block);
+                             succ != succe; ++succ) {
+                            if (mergeStates(blockStates[*succ],states) && inSCC.count(*succ) != 0)
+                                dirty.insert(*succ);
+                        }
+                    }
+                }
+                //Nothing flows back into an SCC once it is done
+                for (BasicBlock *block : blockSCC)
+                    blockStates.erase(block);
+            }
+
+            vector<State> toReturn;
+            for (pair<SynchronizationPoint* const,PathSet> &exitState : exitStates) {
+                State state(&instNumbering);
+                state.lastSynch = exitState.first;
+                state.precedingInstructions = exitState.second;
+                toReturn.push_back(state);
+            }
+            return toReturn;
         }
 
-        //Maps basicblocks to reversestates
-        map<BasicBlock*,SmallPtrSet<State*,2> > visitedBlocks;
-
-        //Maps basicblocks to states that need continuation
-        map<BasicBlock*,vector<State> > speccCaseBackedgeBlocks;
-
-
-        //Delimits synchronization points starting with the specified block
-        //Input: Block to start at and The state before analyzing, as well
-        //as the set to store the first encountered synch points in
-        //(if null, they are not stored). Also takes the block this search
-        //branched from, if any
-        //Returns: A set of states, one for each end point of the search
-        //Side-effects: Updates the synchronization point variables
-        //with the paths discoverable from this basic block
-        vector<State> delimitFromBlock(BasicBlock *curr,vector<State> states,
-                                       Function* addFirstToFun,
-                                       set<CallSite> &noRecurseSet,
-                                       SmallPtrSet<BasicBlock*,64> previousBlocks,
-                                       map<BasicBlock*,SmallPtrSet<Instruction*,64> > &backAddedInsts,
-                                       map<BasicBlock*,SmallPtrSet<BasicBlock*,64> > &backAddedBlocks) {
-            //DEBUG_PRINT("Started a new search branch from BasicBlock: "<< curr->getName() << "\n");
-
-            states=unifyRedundantStates(states);
-
-            map<BasicBlock*,SmallPtrSet<Instruction*,64> > backAddedInstsLocal;
-            map<BasicBlock*,SmallPtrSet<BasicBlock*,64> > backAddedBlocksLocal;
-            
-            //This is the set of states of sub-branches that we need to keep
-            //track of. These will be returned together with the states
-            //obtained in the current search once we return
-            vector<State> finishedSearchStates;
-            
-            while (curr) {
-                LIGHT_PRINT("Handling BasicBlock: " << curr->getName() << "\n");
-                // DEBUG_PRINT("Previously finished basicblocks are:\n");
-                // for (pair<BasicBlock* const,SmallPtrSet<State*,2> > &bb : visitedBlocks)
-                //     DEBUG_PRINT("  " << bb.first->getName() << "\n");
-                // DEBUG_PRINT("Previously visited blocks on this branch are:\n");
-                // for (BasicBlock* bb : previousBlocks)
-                //     DEBUG_PRINT("  " << bb->getName() << "\n");
-                // DEBUG_PRINT("Most recently visited synch points are:\n");
-                // for (State state : states)
-                //     if (state.lastSynch)
-                //         DEBUG_PRINT("  " << state.lastSynch->ID << "\n");
-                //     else
-                //         DEBUG_PRINT("  context begin\n");
-
-                // DEBUG_PRINT("States are:\n");
-                // for (State state : states) {
-                //     if (state.lastSynch != NULL) {
-                //         DEBUG_PRINT("  From synchpoint " << state.lastSynch->ID << "\n");
-                //     } else {
-                //         DEBUG_PRINT("  From context begin\n");
-                //     }
-                //     DEBUG_PRINT("     " << state.precedingInstructions.size() << " instructions\n");
-                //     // for (Instruction * inst : state.precedingInstructions) {
-                //     //     DEBUG_PRINT("   " << *inst << "\n");
-                //     // }
-                // }
-                
-                //If this is true, don't search further
-                bool shortcut=false;
-
-                //Backedge case
-                if (previousBlocks.count(curr) != 0) {
-                    LIGHT_PRINT("Search stopped in block: " << curr->getName() << " due to backedge\n");
-                    for (State state : states) {
-                        auto prev = backAddedInsts[curr];
-                        prev.insert(state.precedingInstructions.begin(),
-                                    state.precedingInstructions.end());
-                        backAddedInsts[curr]=prev;
+        //Tracks the states through a basic block
+        //Side-effects: Updates the synch points encountered in the block, and
+        //the leadingReverseStates of fun for paths from its entry
+        void delimitBlock(BasicBlock *block, StateMap &states, Function *fun) {
+            //The loads and stores between two calls have consecutive IDs, so
+            //they are added to the states as one range once the run ends
+            unsigned runBegin = 0, runEnd = 0;
+            auto addRun = [&]() {
+                if (runBegin == runEnd)
+                    return;
+                for (pair<SynchronizationPoint* const,PathSet> &state : states)
+                    state.second.insertRange(runBegin,runEnd);
+                runBegin = runEnd;
+            };
+            for (BasicBlock::iterator currb_it = block->begin(), curre = block->end();
+                 currb_it != curre; ++currb_it) {
+                Instruction *currb = &*currb_it;
+                if (states.empty())
+                    return;
+                if (isa<StoreInst>(currb) || isa<LoadInst>(currb)) {
+                    unsigned ID = instNumbering.getID(currb);
+                    if (ID != runEnd) {
+                        addRun();
+                        runBegin = ID;
                     }
-                    auto prev = backAddedBlocks[curr];
-                    prev.insert(previousBlocks.begin(),
-                                previousBlocks.end());
-                    backAddedBlocks[curr]=prev;
-                    // //Should not need to return anything extra
-                    // curr=NULL;
-                    // continue;
-                    shortcut=true;
+                    runEnd = ID + 1;
+                    continue;
                 }
-                //Forward-edge case || Back-edge case across synch points
-                if (visitedBlocks.count(curr) != 0) {
-                    LIGHT_PRINT("Search stopped in block: " << curr->getName() << " due to forwardedge or backedge across basicblocks\n");
-                    //We know this path must be completed, thus we simply check
-                    //the mapping and find the reverse states from here
-
-                    bool clearFirstReachable=false;
-
-                    for (State state_ : states) {
-                        //DEBUG_PRINT("Fast-forwarding a state...\n");
-                        speccCaseBackedgeBlocks[curr].push_back(state_);
-                        for (State *state : visitedBlocks[curr]) {
-                            state_.precedingInstructions.insert(state->precedingInstructions.begin(),
-                                                                state->precedingInstructions.end());
-                            updateSynchPointWithState(state_,state->lastSynch);
-                            //If the state reaches context end, return it
-
-                            //Toss the synchpoint upwards if we should
-                            if (addFirstToFun && state->lastSynch != NULL) {
-                                clearFirstReachable=true;
-                                State state__;
-                                state__.precedingInstructions=state_.precedingInstructions;
-                                state__.lastSynch=state->lastSynch;
-                                //LIGHT_PRINT("Added " << state__.lastSynch->ID << " as first reachable in fun " << addFirstToFun->getName() << "(fast-forward)\n");
-                                delimitFunctionDynamic[addFirstToFun].leadingReverseStates.push_back(state__);
-                            }
-                            
-                            if (state->lastSynch == NULL) {
-                                finishedSearchStates.push_back(state_);
+                if (InstructionNumbering::isNumbered(currb))
+                    addRun();
+                //Special case: end search branch at unreachable instruction
+                if (isa<UnreachableInst>(currb)) {
+                    DEBUG_PRINT("Terminated search due to unreachable instruction\n");
+                    states.clear();
+                    return;
+                }
+                if (isSynch(currb)) {
+                    DEBUG_PRINT("Visited instruction that is synch point: " << *currb << "\n");
+                    SynchronizationPoint *synchPoint = getSynchPoint(currb);
+                    for (pair<SynchronizationPoint* const,PathSet> &state : states) {
+                        updateSynchPointWithState(makeState(state.first,state.second),synchPoint);
+                        //Toss the synchpoint upwards if the path came from the function entry
+                        if (state.first == NULL)
+                            addToStates(getAnalysisState(fun).leadingReverseStates,
+                                        synchPoint,state.second);
+                    }
+                    //All tracked paths end here, start a new one
+                    states.clear();
+                    states[synchPoint] = PathSet(&instNumbering);
+                } else if (isCallSite(currb)) {
+                    //If the instruction is a call, figure out which
+                    //function it is
+                    SmallPtrSet<Function*,1> calledFuns = getCalledFuns(currb);
+                    LIGHT_PRINT(calledFuns.size() << " functions could be called\n");
+                    if (calledFuns.size() == 0) {
+                        //We failed to determine which function could
+                        //be called, print an error about this
+                        VERBOSE_PRINT("Failed to determine the function called by: " << *currb << ", ignoring the error\n");
+                        continue;
+                    }
+                    //Each called function is an alternative path through the call
+                    StateMap afterCall;
+                    for (Function* calledFun : calledFuns) {
+                        LIGHT_PRINT("Handling " << calledFun->getName() << "\n");
+                        if (calledFun->empty()) {
+                            //No function body, the call is an analyzed instruction
+                            for (pair<SynchronizationPoint* const,PathSet> &state : states) {
+                                PathSet paths = state.second;
+                                paths.insert(currb);
+                                mergeStates(afterCall,state.first,paths);
                             }
+                        } else {
+                            delimitFunction(calledFun);
+                            spliceCall(calledFun,states,afterCall,fun);
                         }
-                        speccCaseBackedgeBlocks[curr]=unifyRedundantStates(speccCaseBackedgeBlocks[curr]);
                     }
-                    if (clearFirstReachable)
-                        addFirstToFun=NULL;
-                    // curr=NULL;
-                    // continue;
-                    shortcut=true;
+                    states.swap(afterCall);
                 }
+            }
+            addRun();
+        }
 
-                if (shortcut) {
-                    //LIGHT_PRINT("Ended this branch of search\n");
-                    curr=NULL;
+        //Continues the states through a call to an analyzed function
+        //The synch points reachable from the entry of calledFun get the states
+        //as preceding, and the states after the call are merged into afterCall
+        void spliceCall(Function *calledFun, StateMap &states, StateMap &afterCall, Function *fun) {
+            //Copied, for a recursive call the list grows while we splice
+            vector<State> leadStates = getAnalysisState(calledFun).leadingReverseStates;
+            for (State &leadState : leadStates) {
+                if (leadState.lastSynch == NULL)
                     continue;
+                for (pair<SynchronizationPoint* const,PathSet> &state : states) {
+                    State joined = makeState(state.first,state.second);
+                    joined.precedingInstructions |= leadState.precedingInstructions;
+                    updateSynchPointWithState(joined,leadState.lastSynch);
+                    if (state.first == NULL)
+                        addToStates(getAnalysisState(fun).leadingReverseStates,
+                                    leadState.lastSynch,joined.precedingInstructions);
                 }
-                    
-
-                previousBlocks.insert(curr);
-
-                //Analyze the current block
-                for (BasicBlock::iterator currb_it=curr->begin(),
-                         curre=curr->end();
-                     currb_it != curre; ++currb_it) {
-                    Instruction *currb=&*currb_it;
-                    // if (!(allHandledInsts.insert(&*currb).second)) {
-                    //     // DEBUG_PRINT("Instruction was: " << *currb << "\nin basic block: " << curr->getName() << "\n");
-                    //     assert("Handled the same instruction twice!");
-                    // }
-  
-                    // DEBUG_PRINT("Handled instruction: " << *currb << "\n");
-
-                    //Special case: end search branch at unreachable instruction
-                    if (isa<UnreachableInst>(currb)) {
-                        DEBUG_PRINT("Terminated search due to unreachable instruction\n");
-                        // for (BasicBlock* block : previousBlocks) {
-                        //     for (State state : states) {
-                        //         State* newState = new State;
-                        //         newState->lastSynch=NULL;
-                        //         newState->precedingInstructions=state.precedingInstructions;
-                        //         visitedBlocks[block].insert(newState);
-                        //     }
-                        // }
-                                
-                        curr=NULL;
-                        break;
+            }
+            vector<State> trailStates = getAnalysisState(calledFun).trailingStates;
+            for (State &trailState : trailStates) {
+                if (trailState.lastSynch != NULL) {
+                    mergeStates(afterCall,trailState.lastSynch,trailState.precedingInstructions);
+                } else {
+                    //Edge case, there is no synch point on this path through the
+                    //function, the instructions on it continue the current states
+                    for (pair<SynchronizationPoint* const,PathSet> &state : states) {
+                        PathSet paths = state.second;
+                        paths |= trailState.precedingInstructions;
+                        mergeStates(afterCall,state.first,paths);
                     }
-                  
-                    if (isSynch(currb)) {
-                        //Handle synchronization point
-                        //See if we've already visited this point
-                        DEBUG_PRINT("Visited instruction that is synch point: " << *currb << "\n");
-                        SynchronizationPoint *synchPoint = findSynchPoint(synchronizationPoints,currb);
-                        bool visited = true;
-                        if (!synchPoint) {
-                            visited = false;
-                            //DEBUG_PRINT("Was not previously visited\n");
-                            //If not, create a new synchronization point
-                            synchPoint = new SynchronizationPoint;
-                            LIGHT_PRINT("Created synch point ID: " << synchPoint->ID << " : " << *currb << "\n");
-                            synchPoint->val=currb;
-                            synchronizationPoints.insert(synchPoint);
-                            SmallPtrSet<Function*,1> calledFuns = getCalledFuns(currb);
-                            if (anyFunctionNameInSet(calledFuns,critBeginFunctions))
-                                synchPoint->isCritBegin=true;
-                            if (anyFunctionNameInSet(calledFuns,critEndFunctions))
-                                synchPoint->isCritEnd=true;
-                            if (anyFunctionNameInSet(calledFuns,onewayFromFunctions))
-                                synchPoint->isOnewayFrom=true;
-                            if (anyFunctionNameInSet(calledFuns,onewayToFunctions))
-                                synchPoint->isOnewayTo=true;                            
-                        }
-                        //Toss the synchpoint upwards if we should
-                        if (addFirstToFun) {
-                            //Only do this once, we only need to pass
-                            //the first synchpoints we encounter
-                            State newState;
-                            newState.lastSynch = synchPoint;
-                            //We might have several states, but we should only
-                            //have a single synchPoint
-                            for (State state : states) {
-                                newState.precedingInstructions.insert(state.precedingInstructions.begin(),
-                                                                      state.precedingInstructions.end());
-                            }
-                            //LIGHT_PRINT("Added " << newState.lastSynch->ID << " as first reachable in fun(plain)" << addFirstToFun->getName() << "\n");
-                            delimitFunctionDynamic[addFirstToFun].leadingReverseStates.push_back(newState);
-                            //addFirstToFun->push_back(newState);
-                            addFirstToFun=NULL;
-                        }
-                        //Perform updates
-                        for (State &state : states) {
-                            updateSynchPointWithState(state,synchPoint);
-                        }
+                }
+            }
+        }
 
-                        //Update previous basicblocks to shortcut searches through them
-                        for (BasicBlock* block : previousBlocks) {
-                            if (HASMORETHANONEPRED(block)) {
-                                //DEBUG_PRINT("Added BB " << block->getName() << " having the follower Synchpoint " << synchPoint->ID << "\n");
-                                for (State state : states) {
-                                    State* newState = new State;
-                                    newState->lastSynch=synchPoint;
-                                    newState->precedingInstructions=state.precedingInstructions;
-                                    visitedBlocks[block].insert(newState);
-                                }
-                            }
-                        }
+        //Utility: Merges a state into a state map, returns true if the map changed
+        bool mergeStates(StateMap &into, SynchronizationPoint *lastSynch, const PathSet &paths) {
+            StateMap::iterator it = into.find(lastSynch);
+            if (it == into.end()) {
+                into.insert(make_pair(lastSynch,paths));
+                return true;
+            }
+            return it->second.unionWith(paths);
+        }
 
-                        //Clear previous states, all searched paths end here
-                        states.clear();
+        bool mergeStates(StateMap &into, const StateMap &from) {
+            bool changed = false;
+            for (const pair<SynchronizationPoint* const,PathSet> &state : from)
+                changed |= mergeStates(into,state.first,state.second);
+            return changed;
+        }
 
-                        //If we're not the first one here, then someone else
-                        //has already taken care of all the following
-                        //paths and we need not continue
-                        if (visited) {
-                            //Return nothing, everything is already handled
-                            //by previous searches
-                            return vector<State>();
-                        } else {
-                            //Start a new path
-                            State newState;
-                            newState.lastSynch=synchPoint;
-                            states.push_back(newState);
-                            backAddedInstsLocal.clear();
-                            backAddedBlocksLocal.clear();
-                            previousBlocks.clear();
-                        }
-                    } else {
-                        //If the instruction is a call, figure out which
-                        //function it is
-                        if (isCallSite(currb)) {
-                            SmallPtrSet<Function*,1> calledFuns = getCalledFuns(currb);
-                            LIGHT_PRINT(calledFuns.size() << " functions could be called\n");
-                            for (Function* calledFun : calledFuns) {
-                                LIGHT_PRINT("Handling " << calledFun->getName() << "\n");
-                                //Don't recurse on this function call
-                                if (noRecurseSet.count(CallSite(currb)) != 0) {
-                                    // DEBUG_PRINT("DFS path ended in BasicBlock: " << curr->getName() << " due to already processed recursive call\n");
-                                    // curr = NULL;
-                                    // continue;
-                                } else if (!calledFun->empty()) {
-                                    //Parse the function and obtain the states
-                                    //that are at the exit of the function
-                                    // LIGHT_PRINT("Analysing CG of " << calledFun->getName() << "\n");
-                                    delimitFunction(calledFun,noRecurseSet,CallSite(currb));
-                                    //Update the synch points that are accessible from the
-                                    //entry of the function such that their preceding paths
-                                    //contain the current preceding paths
-                                    //DEBUG_PRINT("Function analysis of "<< start->getName()<< " done, updating states and synch points\n");
-                                    //DEBUG_PRINT("Cross size is: " << delimitFunctionDynamic[start].leadingReverseStates.size() << "x"
-                                    //            << states.size() << "\n");
-                                    states=unifyRedundantStates(states);
-                                    // LIGHT_PRINT("Updating current states with states from call to " << calledFun->getName() << "\n");
-                                    // LIGHT_PRINT("Sizes are: " << states.size() << " x " << delimitFunctionDynamic[calledFun].leadingReverseStates.size() << "\n");
-                                    for (State leadState : delimitFunctionDynamic[calledFun].leadingReverseStates) {
-                                        if (leadState.lastSynch != NULL) {
-                                            //DEBUG_PRINT("Updating with leading synchpoint:" << leadState.lastSynch->ID << "\n");
-                                            
-                                            for (State state : states) {
-                                                state.precedingInstructions.insert(leadState.precedingInstructions.begin(),
-                                                                                   leadState.precedingInstructions.end());
-                                                updateSynchPointWithState(state,leadState.lastSynch);
-                                                
-                                                State* newState = new State;
-                                                newState->lastSynch=leadState.lastSynch;
-                                                newState->precedingInstructions=state.precedingInstructions;
-                                                
-                                                if (addFirstToFun && addFirstToFun != calledFun) {
-                                                    //LIGHT_PRINT("Added " << newState->lastSynch->ID << " as first reachable in fun " << addFirstToFun->getName() << "(encountered in function call)\n");
-                                                    delimitFunctionDynamic[addFirstToFun].leadingReverseStates.push_back(*newState);
-                                                }
-                                                
-                                                bool wasAdded=false;
-
-                                                //Update previous basicblocks to shortcut searches through them
-                                                for (BasicBlock* block : previousBlocks) {
-                                                    if (HASMORETHANONEPRED(block)) {
-                                                        //DEBUG_PRINT("Added BB " << block->getName() << " having the follower Synchpoint " << leadState.lastSynch->ID << "\n");
-                                                        wasAdded=true;
-                                                        visitedBlocks[block].insert(newState);
-                                                    }
-                                                }
-                                                if (!wasAdded)
-                                                    delete newState;
-                                            }
-                                        }    
-                                    }
-                                        
-                                    bool clearPrevious=true;
-                                    vector<State> newStates;
-
-                                    // DEBUG_PRINT("Updates done, setup return:\n");
-                                    // DEBUG_PRINT("Cross size is: " << delimitFunctionDynamic[start].trailingStates.size() << "x("
-                                    //             << states.size() << ")\n");
-                                    //DEBUG_PRINT("Setting up new states to use after call...\n");
-                                    for (State trailState : delimitFunctionDynamic[calledFun].trailingStates) {
-                                        
-                                        if (trailState.lastSynch != NULL) {
-                                            //DEBUG_PRINT("Added state from synch point:" << trailState.lastSynch->ID << "\n");
-                                            newStates.push_back(trailState);
-                                        } else {
-                                            //DEBUG_PRINT("Continued states that existed before call due to call having a path with no synch points\n");
-                                            //Edge case, there is no synch point on this path through the
-                                            //function, we need to add the instructions encountered
-                                            //to the preceding states
-                                            //and return accordingly
-                                            clearPrevious=false;
-                                            for (State state : states) {
-                                                state.precedingInstructions.insert(trailState.precedingInstructions.begin(),
-                                                                                   trailState.precedingInstructions.end());
-                                                newStates.push_back(state);
-                                            }
-                                        }
-                                    }
+        //Utility: Adds a state to a list of states, merging it with an existing
+        //state with the same synch point
+        void addToStates(vector<State> &states, SynchronizationPoint *lastSynch, const PathSet &paths) {
+            for (State &state : states) {
+                if (state.lastSynch == lastSynch) {
+                    state.precedingInstructions |= paths;
+                    return;
+                }
+            }
+            states.push_back(makeState(lastSynch,paths));
+        }
 
-                                    if (clearPrevious) {
-                                        previousBlocks.clear();
-                                        addFirstToFun = NULL;
-                                    }
+        State makeState(SynchronizationPoint *lastSynch, const PathSet &paths) {
+            State state(&instNumbering);
+            state.lastSynch = lastSynch;
+            state.precedingInstructions = paths;
+            return state;
+        }
 
-                                    states=newStates;
-                                                                        
-                                } else {
-                                    //DEBUG_PRINT("Added " << calledFun->getName() << " as an analyzed instruction due to it having no function body\n");
-                                    for (State &state : states) {
-                                        state.precedingInstructions.insert(currb);
-                                    }
-                                }
-                                //Continue analysis as usual with those states
-                            }
-                            if (calledFuns.size() == 0) {
-                                //We failed to determine which function could
-                                //be called, print an error about this
-                                VERBOSE_PRINT("Failed to determine the function called by: " << *currb << ", ignoring the error\n");
-                            }
-                        }
-                        else {
-                            //Otherwise, simply add the instruction to the
-                            //states we're tracking
-                            if (isa<StoreInst>(currb) || isa<LoadInst>(currb)) {
-                                for (State &state : states) {
-                                    state.precedingInstructions.insert(currb);
-                                }
-                            }
+        //The call graph SCC of each function delimited on demand, empty for
+        //functions that do not recurse
+        map<Function*,vector<Function*> > recursiveSCCOf;
+
+        //Obtains the SCC start recurses through, or an empty one. Functions
+        //found by an earlier search have complete SCCs and are leaves here
+        vector<Function*> &getRecursiveSCC(Function *start) {
+            map<Function*,vector<Function*> >::iterator it = recursiveSCCOf.find(start);
+            if (it != recursiveSCCOf.end())
+                return it->second;
+            vector<Function*> noCallees;
+            vector<vector<Function*> > sccs =
+                getCallGraphSCCs(vector<Function*>(1,start),[&](Function *fun) -> vector<Function*>& {
+                        return recursiveSCCOf.count(fun) != 0 ? noCallees : getDelimitCallees(fun);
+                    });
+            for (vector<Function*> &scc : sccs) {
+                if (recursiveSCCOf.count(scc.front()) != 0)
+                    continue;
+                vector<Function*> &callees = getDelimitCallees(scc.front());
+                bool recursive = scc.size() > 1 ||
+                    find(callees.begin(),callees.end(),scc.front()) != callees.end();
+                for (Function *fun : scc)
+                    recursiveSCCOf[fun] = recursive ? scc : vector<Function*>();
+            }
+            return recursiveSCCOf[start];
+        }
+
+        //Maps functions to the functions with bodies that delimiting them may
+        //delimit in turn
+        map<Function*,vector<Function*> > delimitCalleesDynamic;
+
+        //Obtains the functions with bodies whose summaries are spliced in when
+        //delimiting fun. Non-synchronized functions are summarized without
+        //delimiting any callees
+        vector<Function*> &getDelimitCallees(Function *fun) {
+            map<Function*,vector<Function*> >::iterator it = delimitCalleesDynamic.find(fun);
+            if (it != delimitCalleesDynamic.end())
+                return it->second;
+            vector<Function*> &toReturn = delimitCalleesDynamic[fun];
+            if (synchronizedFunctions.count(fun) == 0)
+                return toReturn;
+            SmallPtrSet<Function*,8> added;
+            for (inst_iterator it = inst_begin(fun); it != inst_end(fun); ++it) {
+                Instruction *inst = &*it;
+                if (!isCallSite(inst) || isSynch(inst))
+                    continue;
+                for (Function *calledFun : getCalledFuns(inst)) {
+                    if (!calledFun->empty() && added.insert(calledFun).second)
+                        toReturn.push_back(calledFun);
+                }
+            }
+            return toReturn;
+        }
+
+        //Utility: Finds the SCCs of a call graph, as far as it is reachable from
+        //roots. The SCCs are returned bottom-up, that is each SCC comes after
+        //all SCCs it calls into
+        vector<vector<Function*> > getCallGraphSCCs(const vector<Function*> &roots,
+                                                    function<vector<Function*>&(Function*)> getCallees) {
+            vector<vector<Function*> > toReturn;
+            map<Function*,unsigned> index;
+            map<Function*,unsigned> lowlink;
+            vector<Function*> sccStack;
+            SmallPtrSet<Function*,32> onStack;
+            unsigned nextIndex = 0;
+            //Tarjan's algorithm, with an explicit stack to not recurse on the
+            //depth of the call graph
+            struct Frame {
+                Function *fun;
+                unsigned nextCallee;
+            };
+            for (Function *root : roots) {
+                if (index.count(root) != 0)
+                    continue;
+                vector<Frame> dfsStack;
+                index[root] = lowlink[root] = nextIndex++;
+                sccStack.push_back(root);
+                onStack.insert(root);
+                dfsStack.push_back({root,0});
+                while (!dfsStack.empty()) {
+                    Function *fun = dfsStack.back().fun;
+                    vector<Function*> &callees = getCallees(fun);
+                    if (dfsStack.back().nextCallee < callees.size()) {
+                        Function *callee = callees[dfsStack.back().nextCallee++];
+                        if (index.count(callee) == 0) {
+                            index[callee] = lowlink[callee] = nextIndex++;
+                            sccStack.push_back(callee);
+                            onStack.insert(callee);
+                            dfsStack.push_back({callee,0});
+                        } else if (onStack.count(callee) != 0) {
+                            lowlink[fun] = min(lowlink[fun],index[callee]);
                         }
+                        continue;
+                    }
+                    dfsStack.pop_back();
+                    if (!dfsStack.empty())
+                        lowlink[dfsStack.back().fun] = min(lowlink[dfsStack.back().fun],lowlink[fun]);
+                    if (lowlink[fun] == index[fun]) {
+                        vector<Function*> scc;
+                        Function *member;
+                        do {
+                            member = sccStack.back();
+                            sccStack.pop_back();
+                            onStack.erase(member);
+                            scc.push_back(member);
+                        } while (member != fun);
+                        toReturn.push_back(scc);
                     }
                 }
-                if (!curr)
-                    continue;
+            }
+            return toReturn;
+        }
 
-                succ_iterator
-                    bb = succ_begin(curr),
-                    bbe = succ_end(curr);
-                
-                if (curr->getSingleSuccessor())
-                    curr = curr->getSingleSuccessor();
-                else {
-                    if (bb == bbe) {
-                        //LIGHT_PRINT("Search ended in " << curr->getName() << " due to no successing blocks\n");
-                        //Update previous basicblocks to shortcut searches through them
-                        for (BasicBlock* block : previousBlocks) {
-                            //DEBUG_PRINT("Added BB " << block->getName() << " being followed by context end\n");
-                            for (State state : states) {
-                                State* newState = new State;
-                                newState->lastSynch=NULL;
-                                newState->precedingInstructions=state.precedingInstructions;
-                                visitedBlocks[block].insert(newState);
-                            }
-                        }
+        //Delimits all functions reachable from the entry points bottom-up over
+        //the SCCs of the call graph. Each function is delimited once its callees
+        //are, so callers only splice finished summaries. With -spdthreads, SCCs
+        //whose callees are all delimited are handed to a pool of workers
+        void delimitCallGraphBottomUp(SmallPtrSet<Function*,4> &entrypoints) {
+            VERBOSE_PRINT("Delimiting functions bottom-up over the call graph...\n");
+            vector<Function*> roots(entrypoints.begin(),entrypoints.end());
+            vector<vector<Function*> > sccs =
+                getCallGraphSCCs(roots,[this](Function *fun) -> vector<Function*>& {
+                        return getDelimitCallees(fun);
+                    });
+            //Every analysis state is set up front, workers only look them up
+            for (vector<Function*> &scc : sccs)
+                for (Function *fun : scc)
+                    if (delimitFunctionDynamic.count(fun) == 0)
+                        delimitFunctionDynamic[fun]=FunctionAnalysisState();
+
+            if (delimitThreads <= 1) {
+                for (vector<Function*> &scc : sccs)
+                    delimitSCC(scc);
+                return;
+            }
 
-                        finishedSearchStates.insert(finishedSearchStates.end(),
-                                                    states.begin(),states.end());
-                        curr=NULL;
-                        continue;
-                    } else {
-                        for (;bb != bbe; ++bb) {
-                            states.insert(states.end(),
-                                          speccCaseBackedgeBlocks[curr].begin(),
-                                          speccCaseBackedgeBlocks[curr].end());
-                            states=unifyRedundantStates(states);
-                            succ_iterator cheap_tricks = bb;
-                            if (++cheap_tricks == bbe) {
-                                curr = *bb;
-                                continue;
-                            }
-                            LIGHT_PRINT("Branching from BB: " << curr->getName() << ", previousblocks size is " << previousBlocks.size() << "\n");
-                            vector<State> resultStates = delimitFromBlock(*bb,states,addFirstToFun,noRecurseSet,previousBlocks,backAddedInstsLocal,backAddedBlocksLocal);
-                            LIGHT_PRINT("Completed a branch from  BB: " << curr->getName() << "\n");
-                            //All instructions we got back must be added as preceding to all our current
-                            //states, and also our parents
-                            for (auto backadd : backAddedInstsLocal) {
-                                if (previousBlocks.count(backadd.first) != 0) {
-                                    backAddedInsts.insert(backadd);
-                                }
-                            }
+            //The SCC each function is in, and for each SCC the number of callee
+            //SCCs not yet delimited and the SCCs calling into it
+            map<Function*,unsigned> sccOf;
+            for (unsigned i = 0; i < sccs.size(); ++i)
+                for (Function *fun : sccs[i])
+                    sccOf[fun] = i;
+            vector<unsigned> pendingCallees(sccs.size(),0);
+            vector<vector<unsigned> > callerSCCs(sccs.size());
+            deque<unsigned> readySCCs;
+            for (unsigned i = 0; i < sccs.size(); ++i) {
+                set<unsigned> calleeSCCs;
+                for (Function *fun : sccs[i])
+                    for (Function *callee : getDelimitCallees(fun))
+                        if (sccOf[callee] != i)
+                            calleeSCCs.insert(sccOf[callee]);
+                for (unsigned callee : calleeSCCs)
+                    callerSCCs[callee].push_back(i);
+                pendingCallees[i] = calleeSCCs.size();
+                if (calleeSCCs.empty())
+                    readySCCs.push_back(i);
+            }
 
-                            for (State &state : states) {
-                                int totaladded=0;
-                                for (auto backadd : backAddedInsts) {
-                                    totaladded+=backadd.second.size();
-                                    state.precedingInstructions.insert(backadd.second.begin(),
-                                                                       backadd.second.end());
-                                }
-                                DEBUG_PRINT("While handling backaddedinsts, added " << totaladded << " instructions through special backedge cases\n");
-                            }
+            //Functions that do not synchronize share the executable instruction
+            //cache, they are summarized up front
+            for (unsigned i = 0; i < sccs.size(); ++i)
+                if (synchronizedFunctions.count(sccs[i].front()) == 0)
+                    getExecutableInsts(sccs[i].front());
+
+            mutex scheduleMutex;
+            condition_variable scheduleChanged;
+            unsigned finishedSCCs = 0;
+            auto worker = [&]() {
+                unique_lock<mutex> lock(scheduleMutex);
+                while (finishedSCCs < sccs.size()) {
+                    if (readySCCs.empty()) {
+                        scheduleChanged.wait(lock);
+                        continue;
+                    }
+                    unsigned next = readySCCs.front();
+                    readySCCs.pop_front();
+                    lock.unlock();
+                    delimitSCC(sccs[next]);
+                    lock.lock();
+                    finishedSCCs++;
+                    for (unsigned caller : callerSCCs[next])
+                        if (--pendingCallees[caller] == 0)
+                            readySCCs.push_back(caller);
+                    scheduleChanged.notify_all();
+                }
+            };
+            VERBOSE_PRINT("Delimiting " << sccs.size() << " SCCs on " << delimitThreads << " threads\n");
+            vector<thread> workers;
+            for (unsigned i = 0; i < delimitThreads; ++i)
+                workers.push_back(thread(worker));
+            for (thread &t : workers)
+                t.join();
+        }
 
-                            finishedSearchStates.insert(finishedSearchStates.end(),
-                                                        resultStates.begin(),resultStates.end());
-                            //Similarly, all the blocks we got back must be tracked by us and our parents
-                            for (auto backadd : backAddedBlocksLocal) {
-                                if (previousBlocks.count(backadd.first) != 0) {
-                                    backAddedBlocks.insert(backadd);
-                                    previousBlocks.insert(backadd.second.begin(),
-                                                          backadd.second.end());
-                                }
-                            }
-                        }
-                    }    
+        //Delimits the functions of a call graph SCC. Callees outside the SCC are
+        //delimited already, or on demand when they are reached
+        //The functions of a recursive SCC start out with empty summaries and are
+        //delimited again until their summaries stop growing
+        void delimitSCC(vector<Function*> &scc) {
+            Function *first = scc.front();
+            vector<Function*> &firstCallees = getDelimitCallees(first);
+            if (scc.size() == 1 &&
+                find(firstCallees.begin(),firstCallees.end(),first) == firstCallees.end()) {
+                if (getAnalysisState(first).astate != FunctionAnalysisState::Analyzed)
+                    summarizeFunction(first);
+                return;
+            }
+            LIGHT_PRINT("Delimiting recursive SCC of " << scc.size() << " functions\n");
+            //Marked as analyzed, so calls within the SCC splice the current summaries
+            for (Function *fun : scc)
+                getAnalysisState(fun).astate = FunctionAnalysisState::Analyzed;
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (Function *fun : scc) {
+                    FunctionAnalysisState &funState = getAnalysisState(fun);
+                    unsigned before = getSummarySize(funState);
+                    for (State &state : delimitFunctionBody(fun))
+                        addToStates(funState.trailingStates,state.lastSynch,state.precedingInstructions);
+                    if (getSummarySize(funState) != before)
+                        changed = true;
                 }
             }
-            // finishedSearchStates.insert(finishedSearchStates.end(),
-            //                             states.begin(),states.end());
-            unifyRedundantStates(finishedSearchStates);
-            return finishedSearchStates;
+        }
+
+        //Utility: The summaries only grow while a recursive SCC is delimited,
+        //so their total size tells whether any of them changed
+        unsigned getSummarySize(FunctionAnalysisState &funState) {
+            unsigned size = 0;
+            for (State &state : funState.leadingReverseStates)
+                size += 1 + state.precedingInstructions.size();
+            for (State &state : funState.trailingStates)
+                size += 1 + state.precedingInstructions.size();
+            return size;
         }
 
         //Less verbose than printInfo
@@ -970,10 +1292,8 @@ namespace {
                 }
                 //for (Function &fun : wM->getFunctionList()) {
                 for (Function *fun : entryPoints) {
-                    for (State funState : delimitFunctionDynamic[fun].leadingReverseStates) {
-                        if (funState.lastSynch)
-                            outputGraph << "\"" << (fun->getName().data()) << " entry\" -> \"" << PRINTSYNC(funState.lastSynch) << "\";\n";
-                    }
+                    for (SynchronizationPoint *entrySynch : entrySynchs[fun])
+                        outputGraph << "\"" << (fun->getName().data()) << " entry\" -> \"" << PRINTSYNC(entrySynch) << "\";\n";
                 }
 
                 outputGraph << "}\n";
@@ -1084,125 +1404,19 @@ namespace {
         }
 
         //Obtains the set of functions that can be immediately called when
-        //executing inst
+        //executing inst. Atomic inline assembly is returned as
+        //DummyATOMICASMFunc
         SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) {
-            LIGHT_PRINT("Finding functions that can be called by " << *inst << "\n");
             SmallPtrSet<Function*,1> toReturn;
-            SmallPtrSet<Value*,8> alreadyVisited;
-            if (isCallSite(inst)) {
-                LIGHT_PRINT("which is a callsite\n");
-                CallSite call = CallSite(inst);
-                Value *calledValue = call.getCalledValue();
-                //Rather than doing this: would it be possible with a decent AA to just
-                //check if the value aliases with each function in the module?
-                deque<Value*> calledValues;
-                calledValues.push_back(calledValue);
-                while (!calledValues.empty()) {
-                    Value *nextValue = calledValues.front();
-                    calledValues.pop_front();
-                    nextValue = nextValue->stripInBoundsConstantOffsets();
-                    if (alreadyVisited.count(nextValue) != 0)
-                        continue;
-                    alreadyVisited.insert(nextValue);
-                    //Try to resolve the value into a function
-                    if (auto fun = dyn_cast<Function>(nextValue)) {
-                        LIGHT_PRINT(fun->getName() << " could be called\n");
-                        if (noAnalyzeFunctions.count(fun->getName()) == 0)
-                            toReturn.insert(fun);
-                    }
-                    //Since we are dealing with functions, only a few
-                    //instructions should be possible
-                    else if (auto phi = dyn_cast<PHINode>(nextValue))
-                        for (int i = 0; i < phi->getNumIncomingValues(); ++i)
-                            calledValues.push_back(phi->getIncomingValue(i));
-                    else if (dyn_cast<Instruction>(nextValue) && isCallSite(dyn_cast<Instruction>(nextValue))) {
-                        //We get the return from a function, find all values
-                        //that could be returned from that function
-                        //and toss them onto the queue
-                        //TODO: Do we need to handle the case where functions are
-                        //returned recursively?
-                        //For now, ignore it
-                        SmallPtrSet<Function*,1> calledFuns = getCalledFuns(dyn_cast<Instruction>(nextValue));
-                        for (Function* fun : calledFuns) {
-                            for (auto instb = inst_begin(fun);
-                                 instb != inst_end(fun); ++instb) {
-                                if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
-                                    if (Value* returnval = returninst->getReturnValue())
-                                        calledValues.push_back(returnval);
-                                }
-                            }
-                        }
-                    }
-                    //Special case, if we "call" inline assembly we merely need to decide whether the
-                    //assembly synchronizes or not. if there is a "lock" in the aseembly then it synchronizes,
-                    //otherwise it does not
-                    else if (auto inlineasm = dyn_cast<InlineAsm>(nextValue)) {
-                        LIGHT_PRINT("Could call assembly\n");
-                        if (inlineasm->getAsmString().find("lock") != string::npos) {
-                            LIGHT_PRINT("Could call atomic assembly\n");
-                            toReturn.insert(DummyATOMICASMFunc);
-                            LIGHT_PRINT("Returned as " << DummyATOMICASMFunc->getName() << "\n");
-                        }
-                    }
-                    //Here we pick apart data structures
-                    else if (auto gep = dyn_cast<GetElementPtrInst>(nextValue)) {
-                        //Any remaining gep must, by definition, have a dynamic index
-                        //So we just resolve the value that is gepped from
-                        calledValues.push_back(gep->getPointerOperand());
-                    }
-                    // if (auto ext = dyn_cast<ExtractElementInst>(nextValue)) {
-                    //     int index = -1;
-                    //     if (auto cons = dyn_cast<Constant>(ext->getIndexOperand)) {
-                    //         nextValues.push_back(ext->getVectorOperand()->
-                    //     }
-                    // }
-                    else if (auto load = dyn_cast<LoadInst>(nextValue)) {
-                        calledValues.push_back(load->getPointerOperand());
-                    }
-                    else if (auto arg = dyn_cast<Argument>(nextValue)) {
-                        //Track values from the callsites
-                        for (auto use = arg->getParent()->users().begin();
-                             use != arg->getParent()->users().end();
-                             ++use) {
-                            if (dyn_cast<Instruction>(*use) && isCallSite(dyn_cast<Instruction>(*use))) {
-                                CallSite callsite(*use);
-                                calledValues.push_back(callsite.getArgOperand(arg->getArgNo()));
-                            }
-                        }
-                    }
-                    else if (auto glob = dyn_cast<GlobalVariable>(nextValue)) {
-                        //at this point we can basically give up, any function
-                        //that has its adress taken can be used here
-                        //LIGHT_PRINT(*inst << " calls a function stored in a global, finding functions that have their address taken. Global is: " << *glob << "\n");
-                        for (Function &fun : inst->getParent()->getParent()->getParent()->getFunctionList()) {
-                            //LIGHT_PRINT("Considering function: " << fun.getName() << "\n");
-                            if (fun.hasAddressTaken()) {
-                                //LIGHT_PRINT("It has its adress taken\n");
-                                if (fun.getFunctionType() == dyn_cast<FunctionType>(getTypeOfPointerType(glob->getType()))) {
-                                    //LIGHT_PRINT("And the types match\n");
-                                    if (noAnalyzeFunctions.count(fun.getName()) == 0)
-                                        toReturn.insert(&fun);
-                                }
-                            }
-                        }
-                    } else {
-                        //We failed to resolve function to be called. Print diagnostic message
-                        VERBOSE_PRINT("Failed to resolve value: " << *nextValue
-                                      << "\nwhich has type: " << typeid(*nextValue).name()
-                                      << "\nwhile resolving called functions.\n");
-                    }                    
-                }
-            }
+            CallTargetIndex::CallTargets targets = callTargets->getCallTargets(inst);
+            for (Function *fun : targets.funs)
+                if (noAnalyzeFunctions.count(fun->getName()) == 0)
+                    toReturn.insert(fun);
+            if (targets.callsAtomicAsm)
+                toReturn.insert(DummyATOMICASMFunc);
             return toReturn;
         }
         
-        //Utility: Returns the proper type of a pointer type
-        Type *getTypeOfPointerType(Type *ptr) {
-            while (PointerType *p = dyn_cast<PointerType>(ptr))
-                ptr = p->getElementType();
-            return ptr;
-        }
-
         //Utility: Returns true if a set of functions contains a function with
         //a name that is in a stringref set
         bool anyFunctionNameInSet(SmallPtrSet<Function*,1> funs,set<StringRef> stringSet) {
@@ -1220,16 +1434,34 @@ namespace {
             return anyFunctionNameInSet(getCalledFuns(inst),synchFunctions);
         }
 
-        //Utility: Searches a SmallPtrSet for a SynchronizationPoint
-        //with a particular instruction value
-        SynchronizationPoint *findSynchPoint(SmallPtrSet<SynchronizationPoint*,32>
-                                             synchSet, Instruction* inst) {
-            for (SynchronizationPoint *examine : synchSet) {
-                if (examine->val == inst)
-                    return examine;
-            }
-            
-            return NULL;
+        //Maps instructions to the synch points created for them
+        map<Instruction*,SynchronizationPoint*> synchPointOfInst;
+
+        //Guards the creation of synch points and the updates of their edges
+        //when delimiting on several threads
+        mutex synchPointsMutex;
+
+        //Utility: Returns the SynchronizationPoint of an instruction, creating
+        //it the first time the instruction is encountered
+        SynchronizationPoint *getSynchPoint(Instruction *inst) {
+            lock_guard<mutex> lock(synchPointsMutex);
+            SynchronizationPoint *&synchPoint = synchPointOfInst[inst];
+            if (synchPoint)
+                return synchPoint;
+            synchPoint = new SynchronizationPoint;
+            LIGHT_PRINT("Created synch point ID: " << synchPoint->ID << " : " << *inst << "\n");
+            synchPoint->val=inst;
+            synchronizationPoints.insert(synchPoint);
+            SmallPtrSet<Function*,1> calledFuns = getCalledFuns(inst);
+            if (anyFunctionNameInSet(calledFuns,critBeginFunctions))
+                synchPoint->isCritBegin=true;
+            if (anyFunctionNameInSet(calledFuns,critEndFunctions))
+                synchPoint->isCritEnd=true;
+            if (anyFunctionNameInSet(calledFuns,onewayFromFunctions))
+                synchPoint->isOnewayFrom=true;
+            if (anyFunctionNameInSet(calledFuns,onewayToFunctions))
+                synchPoint->isOnewayTo=true;
+            return synchPoint;
         }
         
         //Utility: Given a set of states, returns a set with with each unique
@@ -1255,7 +1487,9 @@ namespace {
 
         //Utility: Given a synch point and a state, updates both as if the
         //state leads to the synch point
-        void updateSynchPointWithState(State state,SynchronizationPoint *synchPoint) {
+        void updateSynchPointWithState(const State &state,SynchronizationPoint *synchPoint) {
+            lock_guard<mutex> lock(synchPointsMutex);
+            SharedPathSet stateInsts = pathSetPool.intern(state.precedingInstructions);
             LIGHT_PRINT("Started an update:\n");
             LIGHT_PRINT("Preceding: ");
             if (state.lastSynch != NULL) {
@@ -1263,8 +1497,8 @@ namespace {
                 LIGHT_PRINT("Updating following instructions of syncpoint " << state.lastSynch->ID << "\n");
                 LIGHT_PRINT("Tracked "<<state.precedingInstructions.size() << " instructions\n");
                 state.lastSynch->following.insert(synchPoint);
-                state.lastSynch->followingInsts[synchPoint].insert(state.precedingInstructions.begin(),
-                                                                   state.precedingInstructions.end());
+                SharedPathSet &followingInsts = state.lastSynch->followingInsts[synchPoint];
+                followingInsts = pathSetPool.unite(followingInsts,stateInsts);
             } else {
                 LIGHT_PRINT("Context begin\n");
             }
@@ -1274,8 +1508,8 @@ namespace {
                 LIGHT_PRINT("Updating preceding instructions of syncpoint " << synchPoint->ID << "\n");
                 LIGHT_PRINT("Tracked "<<state.precedingInstructions.size() << " instructions\n");
                 synchPoint->preceding.insert(state.lastSynch);
-                synchPoint->precedingInsts[state.lastSynch].insert(state.precedingInstructions.begin(),
-                                                                   state.precedingInstructions.end());
+                SharedPathSet &precedingInsts = synchPoint->precedingInsts[state.lastSynch];
+                precedingInsts = pathSetPool.unite(precedingInsts,stateInsts);
             } else {
                 LIGHT_PRINT("Context end\n");
             }
@@ -1332,68 +1566,82 @@ namespace {
             }
         }
 
-        //Utility: Determines whether a SynchronizationPoint should be
-        //in an synchronizationVariable
-        bool aliasWithSynchVar(SynchronizationPoint* synchPoint,SynchronizationVariable* synchVar) {
-            SmallPtrSet<Value*,1> synchPoint1op;
-            if (synchPoint->op != -1)
-                synchPoint1op.insert(synchPoint->val->getOperand(synchPoint->op));
-            else
-                for (int i = 0; i < synchPoint->val->getNumOperands(); ++i)
-                    synchPoint1op.insert(synchPoint->val->getOperand(i));
-            for (SynchronizationPoint *synchPoint2 : synchVar->synchronizationPoints) {
-                //if (pointerConflict(synchPoint->val,synchPoint2->val,wM))
-                if (aacombined->MustConflict(synchPoint->val,synchPoint2->val))
-                    return true;
-                //for (Value* val : synchPoint1op) {
-                
-                // if (synchPoint2->op != -1) {
-                //     if (alias(val,synchPoint2->val->getOperand(synchPoint2->op)))
-                //         return true;
-                // }
-                // else
-                //     for (int i = 0; i < synchPoint2->val->getNumOperands(); ++i)
-                //         if (alias(val,synchPoint2->val->getOperand(i)))
-                //             return true;
-                //}
+        //Utility: Collects the globals the pointer arguments of a synch point
+        //are based on. Returns false if some pointer argument is not based on
+        //a global, in which case the synch point may alias with anything
+        bool getSynchBaseGlobals(SynchronizationPoint *synchPoint, SmallPtrSet<Value*,2> &bases) {
+            CallSite call(synchPoint->val);
+            if (!isNotNull(call))
+                return false;
+            for (Use &arg : call.args()) {
+                if (!isa<PointerType>(arg.get()->getType()))
+                    continue;
+                Value *base = GetUnderlyingObject(arg.get(),wM->getDataLayout(),0);
+                if (!isa<GlobalVariable>(base))
+                    return false;
+                bases.insert(base);
             }
-            return false;
+            return true;
         }
 
         //Sets up the synchronizationVariables structure
+        //Synch points that alias are clustered with a union-find. Synch points
+        //whose lock operands are all based on globals can only alias synch
+        //points based on the same globals when the cheap or the LLVM tier is
+        //asked, so those are only compared against their bucket and against
+        //the synch points that could not be bucketed
         void determineSynchronizationVariables() {
             VERBOSE_PRINT("Determining synchronization variables...\n");
-            for (SynchronizationPoint *synchPoint : synchronizationPoints) {
+            vector<SynchronizationPoint*> synchPoints(synchronizationPoints.begin(),
+                                                      synchronizationPoints.end());
+            sort(synchPoints.begin(),synchPoints.end(),
+                 [](SynchronizationPoint *a, SynchronizationPoint *b) {
+                     return a->ID < b->ID;
+                 });
+            EquivalenceClasses<SynchronizationPoint*> clusters;
+            map<Value*,vector<SynchronizationPoint*> > pointsOfBase;
+            vector<SynchronizationPoint*> unbucketed;
+            vector<SynchronizationPoint*> placed;
+            for (SynchronizationPoint *synchPoint : synchPoints) {
                 VERBOSE_PRINT("Placing synchPoint " << synchPoint->ID << "\n");
-                SmallPtrSet<SynchronizationVariable*,1> toDelete;
-                for (auto it = synchronizationVariables.begin();
-                     it != synchronizationVariables.end();) {
-                    SynchronizationVariable *synchVar = *(it++);
-                    if (aliasWithSynchVar(synchPoint,synchVar)) {
-                        if (synchPoint->synchVar == NULL) {
-                            VERBOSE_PRINT("Was placed into synchVar " << synchVar->ID << "\n");
-                            synchPoint->setSynchronizationVariable(synchVar);
-                        } else {
-                            VERBOSE_PRINT("Merged other synchVar " << synchVar->ID
-                                          << " into synchVar " << synchPoint->synchVar->ID << " due to multiple aliasing\n");
-                            synchPoint->synchVar->merge(synchVar);
-                            toDelete.insert(synchVar);
-                            // synchronizationVariables.erase(synchVar);
-                            // delete(synchVar);
-                        }
+                clusters.insert(synchPoint);
+                SmallPtrSet<Value*,2> bases;
+                //Distinct globals only stay apart if an asked tier proves so
+                bool bucketed = aacombined->separatesDistinctGlobals() && getSynchBaseGlobals(synchPoint,bases);
+                SmallPtrSet<SynchronizationPoint*,8> candidates;
+                if (bucketed) {
+                    for (Value *base : bases)
+                        candidates.insert(pointsOfBase[base].begin(),pointsOfBase[base].end());
+                    candidates.insert(unbucketed.begin(),unbucketed.end());
+                } else
+                    candidates.insert(placed.begin(),placed.end());
+                for (SynchronizationPoint *candidate : candidates) {
+                    if (clusters.isEquivalent(synchPoint,candidate))
+                        continue;
+                    if (aacombined->MustConflict(synchPoint->val,candidate->val)) {
+                        VERBOSE_PRINT("Aliases with synchPoint " << candidate->ID << "\n");
+                        clusters.unionSets(synchPoint,candidate);
                     }
                 }
-                for (SynchronizationVariable * synchVar : toDelete) {
-                    synchronizationVariables.erase(synchVar);
-                    delete(synchVar);
-                }
-                if (synchPoint->synchVar == NULL) {
-                    SynchronizationVariable *newSynchVar = new SynchronizationVariable;
-                    VERBOSE_PRINT("Was not placed into any synchVar, creating new synchVar with ID " << newSynchVar->ID << "\n");
-                    synchPoint->setSynchronizationVariable(newSynchVar);
-                    synchronizationVariables.insert(newSynchVar);
+                if (bucketed)
+                    for (Value *base : bases)
+                        pointsOfBase[base].push_back(synchPoint);
+                else
+                    unbucketed.push_back(synchPoint);
+                placed.push_back(synchPoint);
+            }
+
+            map<SynchronizationPoint*,SynchronizationVariable*> synchVarOfLeader;
+            for (SynchronizationPoint *synchPoint : synchPoints) {
+                SynchronizationVariable *&synchVar = synchVarOfLeader[clusters.getLeaderValue(synchPoint)];
+                if (!synchVar) {
+                    synchVar = new SynchronizationVariable;
+                    VERBOSE_PRINT("Created synchVar with ID " << synchVar->ID << "\n");
+                    synchronizationVariables.insert(synchVar);
                 }
-            }            
+                VERBOSE_PRINT("SynchPoint " << synchPoint->ID << " was placed into synchVar " << synchVar->ID << "\n");
+                synchPoint->setSynchronizationVariable(synchVar);
+            }
         }
 
         void cleanCriticalRegionPrePost() {
@@ -1444,19 +1692,14 @@ namespace {
             //We know what the first synchpoints are in the entry functions, so we
             //start the analysis there
             for (Function *fun : entryPoints) {
-                for (State funState : delimitFunctionDynamic[fun].leadingReverseStates) {
-                    if (funState.lastSynch) {
-                        sectionSynchronizationPointsIntoCriticalRegions(funState.lastSynch);
-                        for (CriticalRegion * region : criticalRegions) {
-                            if (region->containedSynchPoints.count(funState.lastSynch) != 0)
-                                region->firstRegionInEntry=true;
-                        }
+                for (SynchronizationPoint *entrySynch : entrySynchs[fun]) {
+                    sectionSynchronizationPointsIntoCriticalRegions(entrySynch);
+                    for (CriticalRegion * region : criticalRegions) {
+                        if (region->containedSynchPoints.count(entrySynch) != 0)
+                            region->firstRegionInEntry=true;
                     }
                 }
             }
-            
-            if (cleanPrePost)
-                cleanCriticalRegionPrePost();
         }
 
         //Meant to be called initially on one of the first synch points encountered in
@@ -1552,10 +1795,6 @@ namespace {
                     //this critical region
                     critRegion->containedSynchPoints.insert(currState.nextPoint);
                     critRegion->entrySynchPoints.insert(currState.nextPoint);
-                    //Add the synch var used by the synch point to the synchsOn for
-                    //the critical region
-                    critRegion->synchsOn.insert(currState.nextPoint->synchVar);
-
                     SearchState newSearchState;
                     newSearchState.searchDepth=1;
                     newSearchState.currRegion=critRegion;
@@ -1616,10 +1855,6 @@ namespace {
                     newSearchState.releasesSinceRegionStart=currState.releasesSinceRegionStart;
                     //We might do some redundant work here, but it is fine
                     critRegion->containedSynchPoints.insert(currState.nextPoint);
-                    //Add the synch var used by the synch point to the synchsOn for
-                    //the critical region
-                    critRegion->synchsOn.insert(currState.nextPoint->synchVar);
-                    
                     //If this synch point begins a critical region, increase
                     //nesting level
                     if (currState.nextPoint->isCritBegin) {
@@ -1770,34 +2005,60 @@ namespace {
 
         }
 
-        map<Function*,SmallPtrSet<Instruction*,128> > getExecutableInstsDynamic;
-
-        //Obtains all functions executable when executing fun
-        SmallPtrSet<Instruction*,128> getExecutableInsts(Function *fun) {
-            SmallPtrSet<Function*,4> visitedFuns;
-            return getExecutableInstsDynamic[fun]=getExecutableInstsProper(fun,visitedFuns);
+        //The loads and stores executable when executing a function, shared by
+        //every call site of it
+        map<Function*,PathSet> getExecutableInstsDynamic;
+
+        //Maps functions to the functions with bodies they may call
+        map<Function*,vector<Function*> > executableCalleesDynamic;
+
+        vector<Function*> &getExecutableCallees(Function *fun) {
+            map<Function*,vector<Function*> >::iterator it = executableCalleesDynamic.find(fun);
+            if (it != executableCalleesDynamic.end())
+                return it->second;
+            vector<Function*> &toReturn = executableCalleesDynamic[fun];
+            SmallPtrSet<Function*,8> added;
+            for (inst_iterator it = inst_begin(fun); it != inst_end(fun); ++it)
+                for (Function *calledFun : getCalledFuns(&*it))
+                    if (!calledFun->empty() && added.insert(calledFun).second)
+                        toReturn.push_back(calledFun);
+            return toReturn;
         }
 
-        SmallPtrSet<Instruction*,128> getExecutableInstsProper(Function *fun, SmallPtrSet<Function*,4> &visitedFuns) {
-            if (getExecutableInstsDynamic.count(fun) != 0)
-                return getExecutableInstsDynamic[fun];
-
-            SmallPtrSet<Instruction*,128> toReturn;
-            if (visitedFuns.insert(fun).second) {
-                for (inst_iterator it = inst_begin(fun);
-                     it != inst_end(fun);
-                     ++it) {
-                    Instruction *inst = &*it;
-                    if (isa<StoreInst>(inst) || isa<LoadInst>(inst))
-                        toReturn.insert(inst);
-                    SmallPtrSet<Function*,1> calledFuns = getCalledFuns(inst);
-                    for (Function *cFun : calledFuns) {
-                        SmallPtrSet<Instruction*,128> returned = getExecutableInstsProper(cFun,visitedFuns);
-                        toReturn.insert(returned.begin(),returned.end());
-                    }
+        //Obtains all loads and stores executable when executing fun. The
+        //summaries are computed bottom-up over the SCCs of the call graph below
+        //fun, so functions in a recursive cycle all get the accesses of the
+        //whole cycle. Functions summarized by an earlier call are leaves, so
+        //only the part of the call graph not yet summarized is walked
+        const PathSet &getExecutableInsts(Function *fun) {
+            map<Function*,PathSet>::iterator it = getExecutableInstsDynamic.find(fun);
+            if (it != getExecutableInstsDynamic.end())
+                return it->second;
+            vector<Function*> roots(1,fun);
+            vector<Function*> noCallees;
+            vector<vector<Function*> > sccs =
+                getCallGraphSCCs(roots,[&](Function *caller) -> vector<Function*>& {
+                        return getExecutableInstsDynamic.count(caller) != 0 ?
+                            noCallees : getExecutableCallees(caller);
+                    });
+            for (vector<Function*> &scc : sccs) {
+                //SCCs are whole, so one summarized member means all are
+                if (getExecutableInstsDynamic.count(scc.front()) != 0)
+                    continue;
+                SmallPtrSet<Function*,4> inSCC(scc.begin(),scc.end());
+                PathSet summary(&instNumbering);
+                for (Function *member : scc) {
+                    for (inst_iterator it = inst_begin(member); it != inst_end(member); ++it)
+                        if (isa<StoreInst>(&*it) || isa<LoadInst>(&*it))
+                            summary.insert(&*it);
+                    for (Function *callee : getExecutableCallees(member))
+                        if (inSCC.count(callee) == 0)
+                            summary |= getExecutableInstsDynamic[callee];
                 }
+                for (Function *member : scc)
+                    getExecutableInstsDynamic[member] = summary;
             }
-            return toReturn;
+            return getExecutableInstsDynamic[fun];
         }
         
         //We color the synchronization points reachable from some synchronization point that creates threads
@@ -1822,7 +2083,7 @@ namespace {
                     //synch point in the main thread, instructions towards that can be manually removed
                     //from mains leadingReverseStates instead
                     if (coloredSynchs.count(pred) == 0) {
-                        synchPoint->precedingInsts[pred].clear();
+                        synchPoint->precedingInsts[pred] = SharedPathSet();
                         // if (pred)
                         //     VERBOSE_PRINT("Cleaned instruction from synchpoint " << synchPoint->ID << " to synchpoint " << pred -> ID << "\n");
                         // else
@@ -1831,7 +2092,7 @@ namespace {
                 }
                 for (SynchronizationPoint *follow : synchPoint->following) {
                     if (coloredSynchs.count(follow) == 0) {
-                        synchPoint->followingInsts[follow].clear();
+                        synchPoint->followingInsts[follow] = SharedPathSet();
                         // if (follow)
                         //     VERBOSE_PRINT("Cleaned instruction from synchpoint " << synchPoint->ID << " to synchpoint " << follow -> ID << "\n");
                         // else
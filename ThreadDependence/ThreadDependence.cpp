@@ -58,6 +58,8 @@
 #include "llvm/Pass.h"
 //#include "llvm/Support/InstIterator.h"
 
+#include "../CallTargetIndex/CallTargetIndexPass.cpp"
+
 
 //#include "../Utils/SkelUtils/CallingDAE.cpp"
 //#include "../Utils/SkelUtils/MetadataInfo.h"
@@ -88,6 +90,7 @@ namespace {
     public:
         int DR_ID;
         virtual void getAnalysisUsage(AnalysisUsage &AU) const{
+            AU.addRequired<CallTargetIndexPass>();
             // AU.addRequired<AssumptionCacheTracker>();
             // AU.addRequired<TargetLibraryInfoWrapperPass>();
             AU.addRequired<ScalarEvolutionWrapperPass>();
@@ -99,6 +102,7 @@ namespace {
             // These functions can be threads
             SmallPtrSet<Function*,4> thrdFunctions;
             assert(M.getFunction("pthread_create") && "Module does not spawn threads.");
+            callTargets = &getAnalysis<CallTargetIndexPass>().getIndex();
             findEntryPoints(M,thrdFunctions);
 
             //Mark all values whose values depend on a thread-starting functions argument
@@ -129,6 +133,9 @@ namespace {
 
         SmallPtrSet<Value*,256> threadDependantValues;
 
+        //Shared index of what each call site may call
+        CallTargetIndex *callTargets;
+
         //Utility: Checks wether a given callsite contains a call
         bool isNotNull(CallSite call) {
             return call.isCall() || call.isInvoke();
@@ -214,124 +221,13 @@ namespace {
         //Obtains the set of functions that can be immediately called when
         //executing inst
         SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) {
-            LIGHT_PRINT("Finding functions that can be called by " << *inst << "\n");
             SmallPtrSet<Function*,1> toReturn;
-            SmallPtrSet<Value*,8> alreadyVisited;
-            if (isCallSite(inst)) {
-                LIGHT_PRINT("which is a callsite\n");
-                CallSite call = CallSite(inst);
-                Value *calledValue = call.getCalledValue();
-                //Rather than doing this: would it be possible with a decent AA to just
-                //check if the value aliases with each function in the module?
-                deque<Value*> calledValues;
-                calledValues.push_back(calledValue);
-                while (!calledValues.empty()) {
-                    Value *nextValue = calledValues.front();
-                    calledValues.pop_front();
-                    nextValue = nextValue->stripInBoundsConstantOffsets();
-                    if (alreadyVisited.count(nextValue) != 0)
-                        continue;
-                    alreadyVisited.insert(nextValue);
-                    //Try to resolve the value into a function
-                    if (auto fun = dyn_cast<Function>(nextValue)) {
-                        LIGHT_PRINT(fun->getName() << " could be called\n");
-                        if (noAnalyzeFunctions.count(fun->getName()) == 0)
-                            toReturn.insert(fun);
-                    }
-                    //Since we are dealing with functions, only a few
-                    //instructions should be possible
-                    else if (auto phi = dyn_cast<PHINode>(nextValue))
-                        for (int i = 0; i < phi->getNumIncomingValues(); ++i)
-                            calledValues.push_back(phi->getIncomingValue(i));
-                    else if (dyn_cast<Instruction>(nextValue) && isCallSite(dyn_cast<Instruction>(nextValue))) {
-                        //We get the return from a function, find all values
-                        //that could be returned from that function
-                        //and toss them onto the queue
-                        //TODO: Do we need to handle the case where functions are
-                        //returned recursively?
-                        //For now, ignore it
-                        SmallPtrSet<Function*,1> calledFuns = getCalledFuns(dyn_cast<Instruction>(nextValue));
-                        for (Function* fun : calledFuns) {
-                            for (auto instb = inst_begin(fun);
-                                 instb != inst_end(fun); ++instb) {
-                                if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
-                                    if (Value* returnval = returninst->getReturnValue())
-                                        calledValues.push_back(returnval);
-                                }
-                            }
-                        }
-                    }
-                    //Don't need to concern ourselves with this
-                    //Special case, if we "call" inline assembly we merely need to decide whether the
-                    //assembly synchronizes or not. if there is a "lock" in the aseembly then it synchronizes,
-                    //otherwise it does not
-                    // else if (auto inlineasm = dyn_cast<InlineAsm>(nextValue)) {
-                    //     LIGHT_PRINT("Could call assembly\n");
-                    //     if (inlineasm->getAsmString().find("lock") != string::npos) {
-                    //         LIGHT_PRINT("Could call atomic assembly\n");
-                    //         toReturn.insert(DummyATOMICASMFunc);
-                    //         LIGHT_PRINT("Returned as " << DummyATOMICASMFunc->getName() << "\n");
-                    //     }
-                    // }
-                    //Here we pick apart data structures
-                    else if (auto gep = dyn_cast<GetElementPtrInst>(nextValue)) {
-                        //Any remaining gep must, by definition, have a dynamic index
-                        //So we just resolve the value that is gepped from
-                        calledValues.push_back(gep->getPointerOperand());
-                    }
-                    // if (auto ext = dyn_cast<ExtractElementInst>(nextValue)) {
-                    //     int index = -1;
-                    //     if (auto cons = dyn_cast<Constant>(ext->getIndexOperand)) {
-                    //         nextValues.push_back(ext->getVectorOperand()->
-                    //     }
-                    // }
-                    else if (auto load = dyn_cast<LoadInst>(nextValue)) {
-                        calledValues.push_back(load->getPointerOperand());
-                    }
-                    else if (auto arg = dyn_cast<Argument>(nextValue)) {
-                        //Track values from the callsites
-                        for (auto use = arg->getParent()->users().begin();
-                             use != arg->getParent()->users().end();
-                             ++use) {
-                            if (dyn_cast<Instruction>(*use) && isCallSite(dyn_cast<Instruction>(*use))) {
-                                CallSite callsite(*use);
-                                calledValues.push_back(callsite.getArgOperand(arg->getArgNo()));
-                            }
-                        }
-                    }
-                    else if (auto glob = dyn_cast<GlobalVariable>(nextValue)) {
-                        //at this point we can basically give up, any function
-                        //that has its adress taken can be used here
-                        //LIGHT_PRINT(*inst << " calls a function stored in a global, finding functions that have their address taken. Global is: " << *glob << "\n");
-                        for (Function &fun : inst->getParent()->getParent()->getParent()->getFunctionList()) {
-                            //LIGHT_PRINT("Considering function: " << fun.getName() << "\n");
-                            if (fun.hasAddressTaken()) {
-                                //LIGHT_PRINT("It has its adress taken\n");
-                                if (fun.getFunctionType() == dyn_cast<FunctionType>(getTypeOfPointerType(glob->getType()))) {
-                                    //LIGHT_PRINT("And the types match\n");
-                                    if (noAnalyzeFunctions.count(fun.getName()) == 0)
-                                        toReturn.insert(&fun);
-                                }
-                            }
-                        }
-                    } else {
-                        //We failed to resolve function to be called. Print diagnostic message
-                        VERBOSE_PRINT("Failed to resolve value: " << *nextValue
-                                      << "\nwhich has type: " << typeid(*nextValue).name()
-                                      << "\nwhile resolving called functions.\n");
-                    }                    
-                }
-            }
+            for (Function *fun : callTargets->getCalledFuns(inst))
+                if (noAnalyzeFunctions.count(fun->getName()) == 0)
+                    toReturn.insert(fun);
             return toReturn;
         }
         
-        //Utility: Returns the proper type of a pointer type
-        Type *getTypeOfPointerType(Type *ptr) {
-            while (PointerType *p = dyn_cast<PointerType>(ptr))
-                ptr = p->getElementType();
-            return ptr;
-        }
-
         
         
         //Gets the possible highes-level pointers who can only refer to locations that the argument could refer to
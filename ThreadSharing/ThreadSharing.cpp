@@ -0,0 +1,289 @@
+//=== Determines the values that may point to memory reachable by several threads ==//
+//
+//
+//===----------------------------------------------------------------------===//
+// Every global, argument and instruction of the module is given a dense ID and
+// a single fixpoint over the value graph marks the ones that may refer to
+// memory another thread can reach. Clients then ask in constant time
+//===----------------------------------------------------------------------===//
+
+#ifndef _THREADSHARING_
+#define _THREADSHARING_
+
+#include <set>
+#include <map>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Debug.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/InstIterator.h"
+
+#include "llvm/Pass.h"
+
+#include "../CallTargetIndex/CallTargetIndexPass.cpp"
+
+#define LIBRARYNAME "ThreadSharing"
+
+//Define moderately pretty printing functions
+#define PRINTSTREAM errs()
+#define PRINT PRINTSTREAM << LIBRARYNAME": "
+#define PRINT_DEBUG PRINTSTREAM << LIBRARYNAME"(debug): "
+
+//Verbose prints things like progress
+#define VERBOSE_PRINT(X) DEBUG_WITH_TYPE(LIBRARYNAME"-verbose",PRINT << X)
+//Light prints things like more detailed progress
+#define LIGHT_PRINT(X) DEBUG_WITH_TYPE(LIBRARYNAME"-light",PRINT << X)
+//Debug should more accurately print exactly what is happening
+#define DEBUG_PRINT(X) DEBUG_WITH_TYPE(LIBRARYNAME"-debug",PRINT_DEBUG << X)
+
+using namespace llvm;
+using namespace std;
+
+namespace {
+    struct ThreadSharing : public ModulePass {
+        static char ID;
+        ThreadSharing() : ModulePass(ID) {}
+
+    public:
+        virtual void getAnalysisUsage(AnalysisUsage &AU) const{
+            AU.addRequired<CallTargetIndexPass>();
+            AU.setPreservesAll();
+        }
+
+        //A value is shared if it is a global, reaches a function whose
+        //address is taken, is derived from a shared value, or escapes by
+        //being stored into shared memory or handed to a new thread
+        virtual bool runOnModule(Module &M) {
+            callTargets = &getAnalysis<CallTargetIndexPass>().getIndex();
+            numberValues(M);
+
+            //Seed with what other threads can reach directly
+            for (GlobalVariable &glob : M.getGlobalList())
+                markShared(&glob);
+            for (Function &fun : M.getFunctionList()) {
+                if (fun.hasAddressTaken())
+                    for (Argument &arg : fun.getArgumentList())
+                        markShared(&arg);
+                for (inst_iterator it = inst_begin(&fun); it != inst_end(&fun); ++it) {
+                    Instruction *inst = &*it;
+                    if (!isCallSite(inst) || !callsThreadFunction(inst))
+                        continue;
+                    CallSite call(inst);
+                    for (Use &arg : call.args())
+                        if (isa<PointerType>(arg.get()->getType()))
+                            markEscaped(arg.get());
+                }
+            }
+
+            //Sharing only grows, so sweep until nothing changes
+            unsigned sweeps = 0;
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                sweeps++;
+                for (Function &fun : M.getFunctionList())
+                    for (inst_iterator it = inst_begin(&fun); it != inst_end(&fun); ++it)
+                        changed = propagate(&*it) || changed;
+            }
+
+            VERBOSE_PRINT("Marked " << shared.count() << " of " << values.size() << " values as shared in " << sweeps << " sweeps\n");
+            return false;
+        }
+
+        bool isShared(Value *val) {
+            DenseMap<Value*,unsigned>::iterator it = IDs.find(val);
+            if (it != IDs.end())
+                return shared.test(it->second);
+            //Constant expressions are not numbered, they are shared if they
+            //are built from something shared
+            if (auto constExpr = dyn_cast<ConstantExpr>(val)) {
+                for (Use &op : constExpr->operands())
+                    if (isShared(op.get()))
+                        return true;
+            }
+            return false;
+        }
+
+    private:
+
+        //Shared index of what each call site may call
+        CallTargetIndex *callTargets;
+
+        DenseMap<Value*,unsigned> IDs;
+        vector<Value*> values;
+        BitVector shared;
+        //The values each function may return
+        map<Function*,vector<Value*> > returnValues;
+        //The call sites that may call each function
+        map<Function*,vector<Instruction*> > callSitesOf;
+
+        //These are the function to treat as if they spawn new
+        //threads
+        set<StringRef> threadFunctions = {"pthread_create"};
+
+        //Utility: Checks whether an instruction could be a callsite
+        bool isCallSite(Instruction* inst) {
+            CallSite call(inst);
+            return call.isCall() || call.isInvoke();
+        }
+
+        bool callsThreadFunction(Instruction *inst) {
+            for (Function *fun : callTargets->getCalledFuns(inst))
+                if (threadFunctions.count(fun->getName()) != 0)
+                    return true;
+            return false;
+        }
+
+        void numberValues(Module &M) {
+            IDs.clear();
+            values.clear();
+            returnValues.clear();
+            callSitesOf.clear();
+            auto number = [&](Value *val) {
+                IDs[val] = values.size();
+                values.push_back(val);
+            };
+            for (GlobalVariable &glob : M.getGlobalList())
+                number(&glob);
+            for (Function &fun : M.getFunctionList()) {
+                for (Argument &arg : fun.getArgumentList())
+                    number(&arg);
+                for (inst_iterator it = inst_begin(&fun); it != inst_end(&fun); ++it) {
+                    number(&*it);
+                    if (isCallSite(&*it))
+                        for (Function *called : callTargets->getCalledFuns(&*it))
+                            callSitesOf[called].push_back(&*it);
+                    if (auto ret = dyn_cast<ReturnInst>(&*it))
+                        if (ret->getReturnValue())
+                            returnValues[&fun].push_back(ret->getReturnValue());
+                }
+            }
+            shared = BitVector(values.size());
+        }
+
+        //Returns true if the value was not shared before
+        bool markShared(Value *val) {
+            DenseMap<Value*,unsigned>::iterator it = IDs.find(val);
+            if (it == IDs.end() || shared.test(it->second))
+                return false;
+            DEBUG_PRINT("Marked " << *val << " as shared\n");
+            shared.set(it->second);
+            return true;
+        }
+
+        //Marks a pointer that is made reachable by another thread, together
+        //with the pointers it was computed from, as they refer to the same
+        //memory. An escaping argument escapes what the callers pass for it,
+        //and an escaping call result what the callees return. A loaded
+        //pointer escapes the memory it was loaded from, so whatever is
+        //stored there escapes as well
+        bool markEscaped(Value *val) {
+            bool changed = false;
+            SmallPtrSet<Value*,8> visited;
+            vector<Value*> worklist(1,val);
+            while (!worklist.empty()) {
+                Value *next = worklist.back();
+                worklist.pop_back();
+                if (!visited.insert(next).second)
+                    continue;
+                changed = markShared(next) || changed;
+                if (auto gep = dyn_cast<GetElementPtrInst>(next))
+                    worklist.push_back(gep->getPointerOperand());
+                else if (auto castInst = dyn_cast<CastInst>(next))
+                    worklist.push_back(castInst->getOperand(0));
+                else if (auto phi = dyn_cast<PHINode>(next))
+                    worklist.insert(worklist.end(),phi->incoming_values().begin(),phi->incoming_values().end());
+                else if (auto select = dyn_cast<SelectInst>(next)) {
+                    worklist.push_back(select->getTrueValue());
+                    worklist.push_back(select->getFalseValue());
+                }
+                else if (auto load = dyn_cast<LoadInst>(next))
+                    worklist.push_back(load->getPointerOperand());
+                else if (auto arg = dyn_cast<Argument>(next)) {
+                    for (Instruction *callInst : callSitesOf[arg->getParent()]) {
+                        CallSite call(callInst);
+                        if (arg->getArgNo() < call.arg_size())
+                            worklist.push_back(call.getArgument(arg->getArgNo()));
+                    }
+                }
+                else if (isa<Instruction>(next) && isCallSite(cast<Instruction>(next))) {
+                    for (Function *fun : callTargets->getCalledFuns(cast<Instruction>(next)))
+                        worklist.insert(worklist.end(),returnValues[fun].begin(),returnValues[fun].end());
+                }
+            }
+            return changed;
+        }
+
+        //Applies the rules for one instruction, returns true if anything
+        //new was marked
+        bool propagate(Instruction *inst) {
+            bool changed = false;
+            if (auto store = dyn_cast<StoreInst>(inst)) {
+                //Storing into shared memory lets other threads reach the value
+                if (isShared(store->getPointerOperand())) {
+                    changed = markShared(store) || changed;
+                    if (isa<PointerType>(store->getValueOperand()->getType()))
+                        changed = markEscaped(store->getValueOperand()) || changed;
+                }
+                return changed;
+            }
+            if (isCallSite(inst)) {
+                CallSite call(inst);
+                for (Function *fun : callTargets->getCalledFuns(inst)) {
+                    //Shared arguments are shared in the callee
+                    for (Argument &arg : fun->getArgumentList())
+                        if (arg.getArgNo() < call.arg_size() && isShared(call.getArgument(arg.getArgNo())))
+                            changed = markShared(&arg) || changed;
+                    //Shared returns are shared in the caller
+                    for (Value *returned : returnValues[fun])
+                        if (isShared(returned))
+                            changed = markShared(inst) || changed;
+                }
+                return changed;
+            }
+            //Loads, geps, casts, phis and selects are shared if what they
+            //are computed from is
+            if (isa<LoadInst>(inst)) {
+                if (isShared(cast<LoadInst>(inst)->getPointerOperand()))
+                    changed = markShared(inst);
+                return changed;
+            }
+            if (isa<GetElementPtrInst>(inst) || isa<CastInst>(inst) ||
+                isa<PHINode>(inst) || isa<SelectInst>(inst)) {
+                for (Use &op : inst->operands())
+                    if (isShared(op.get())) {
+                        changed = markShared(inst);
+                        break;
+                    }
+            }
+            return changed;
+        }
+    };
+}
+
+char ThreadSharing::ID = 0;
+static RegisterPass<ThreadSharing> W("thread-sharing",
+                                     "Determines the values that may refer to memory reachable by several threads",
+                                     true,
+                                     true);
+
+#endif
+
+/* Local Variables: */
+/* mode: c++ */
+/* indent-tabs-mode: nil */
+/* c-basic-offset: 4 */
+/* End: */
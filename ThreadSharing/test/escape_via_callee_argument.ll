@@ -0,0 +1,39 @@
+; A pointer escapes through a callee that stores its argument into a global.
+; The malloc result %p in @worker must be marked shared, so the store through
+; it stays a candidate for conflicts.
+;
+; opt -load ThreadSharing.so -thread-sharing -debug-only=ThreadSharing-debug \
+;     -disable-output escape_via_callee_argument.ll 2>&1 | grep "Marked"
+;
+; Expected to include:
+;   Marked   %p = call i8* @malloc(i64 4) as shared
+;   Marked   store i32 1, i32* %p.int, align 4 as shared
+
+@registered = global i32* null, align 8
+
+declare i8* @malloc(i64)
+declare i32 @pthread_create(i64*, i8*, i8* (i8*)*, i8*)
+
+define void @reg(i32* %q) {
+entry:
+  store i32* %q, i32** @registered, align 8
+  ret void
+}
+
+define i8* @worker(i8* %unused) {
+entry:
+  %p = call i8* @malloc(i64 4)
+  %p.int = bitcast i8* %p to i32*
+  call void @reg(i32* %p.int)
+  store i32 1, i32* %p.int, align 4
+  ret i8* null
+}
+
+define i32 @main() {
+entry:
+  %thread = alloca i64, align 8
+  %call = call i32 @pthread_create(i64* %thread, i8* null, i8* (i8*)* @worker, i8* null)
+  %shared = load i32*, i32** @registered, align 8
+  store i32 2, i32* %shared, align 4
+  ret i32 0
+}
@@ -0,0 +1,39 @@
+; A pointer escapes after a round trip through a local variable, as clang
+; emits at -O0. The malloc result is stored into %p.addr, loaded back and
+; the loaded copy is stored into a global. The malloc result in @worker must
+; be marked shared, so the store through it stays a candidate for conflicts.
+;
+; opt -load ThreadSharing.so -thread-sharing -debug-only=ThreadSharing-debug \
+;     -disable-output escape_via_local_variable.ll 2>&1 | grep "Marked"
+;
+; Expected to include:
+;   Marked   %p.addr = alloca i32*, align 8 as shared
+;   Marked   %p = call i8* @malloc(i64 4) as shared
+;   Marked   store i32 1, i32* %1, align 4 as shared
+
+@registered = global i32* null, align 8
+
+declare i8* @malloc(i64)
+declare i32 @pthread_create(i64*, i8*, i8* (i8*)*, i8*)
+
+define i8* @worker(i8* %unused) {
+entry:
+  %p.addr = alloca i32*, align 8
+  %p = call i8* @malloc(i64 4)
+  %p.int = bitcast i8* %p to i32*
+  store i32* %p.int, i32** %p.addr, align 8
+  %0 = load i32*, i32** %p.addr, align 8
+  store i32* %0, i32** @registered, align 8
+  %1 = load i32*, i32** %p.addr, align 8
+  store i32 1, i32* %1, align 4
+  ret i8* null
+}
+
+define i32 @main() {
+entry:
+  %thread = alloca i64, align 8
+  %call = call i32 @pthread_create(i64* %thread, i8* null, i8* (i8*)* @worker, i8* null)
+  %shared = load i32*, i32** @registered, align 8
+  store i32 2, i32* %shared, align 4
+  ret i32 0
+}
@@ -0,0 +1,87 @@
+//===-------- Pool of threads kept alive between parallel jobs ------------===//
+//
+//
+//===----------------------------------------------------------------------===//
+// run() hands the same job to every worker and returns once all of them are
+// done with it. Workers started by start() only take jobs posted after it, so
+// a run() right after start() is never missed
+//===----------------------------------------------------------------------===//
+
+#ifndef _WORKERPOOL_
+#define _WORKERPOOL_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+class WorkerPool {
+public:
+  ~WorkerPool() {
+    stop();
+  }
+
+  unsigned size() const {
+    return workers.size();
+  }
+
+  //The generation is read here, under the lock, rather than by the new
+  //threads, which may only get to run after the next job is posted
+  void start(unsigned threads) {
+    lock_guard<mutex> lock(poolMutex);
+    while (workers.size() < threads) {
+      unsigned seen = generation;
+      workers.push_back(thread([this,seen]() {work(seen);}));
+    }
+  }
+
+  void run(function<void()> toRun) {
+    unique_lock<mutex> lock(poolMutex);
+    job = toRun;
+    busy = workers.size();
+    ++generation;
+    jobPosted.notify_all();
+    jobDone.wait(lock,[this]() {return busy == 0;});
+    job = function<void()>();
+  }
+
+  void stop() {
+    {
+      lock_guard<mutex> lock(poolMutex);
+      stopping = true;
+    }
+    jobPosted.notify_all();
+    for (thread &worker : workers)
+      worker.join();
+    workers.clear();
+    stopping = false;
+  }
+
+private:
+  vector<thread> workers;
+  mutex poolMutex;
+  condition_variable jobPosted, jobDone;
+  function<void()> job;
+  unsigned generation=0, busy=0;
+  bool stopping=false;
+
+  void work(unsigned done) {
+    unique_lock<mutex> lock(poolMutex);
+    while (true) {
+      jobPosted.wait(lock,[&]() {return stopping || generation != done;});
+      if (stopping)
+        return;
+      done = generation;
+      lock.unlock();
+      job();
+      lock.lock();
+      if (--busy == 0)
+        jobDone.notify_all();
+    }
+  }
+};
+
+#endif
@@ -19,7 +19,12 @@
 // #include <list>
 // #include <map>
 #include <utility>
-// #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -30,6 +35,7 @@
 // #include "llvm/ADT/ArrayRef.h"
 // #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/BitVector.h"
 
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
@@ -71,6 +77,8 @@
 #include "../SynchPointDelim/SynchPointDelim.cpp"
 #include "../SynchPointDelim/SynchPoint.hpp"
 #include "../PointerAliasing/AliasCombiner.cpp"
+#include "../CallTargetIndex/CallTargetIndexPass.cpp"
+#include "WorkerPool.hpp"
 //#include "../ThreadDependantAnalysis/ThreadDependance.cpp"
 #include "../SVF-master/include/WPA/WPAPass.h"
 
@@ -120,6 +128,11 @@ static cl::opt<AliasResult> ALIASLEVEL("aalevel",cl::desc("The required aliasing
                                                   clEnumVal(MustAlias,"Only loads and stores that are proven to point to the same location will conflict"),
                                                   clEnumValEnd));
 
+static cl::opt<bool> bucketConflicts("bucketconflicts",cl::desc("Only check accesses and regions for conflicts if they may refer to a common abstract memory object"));
+
+static cl::opt<unsigned> crossCheckThreads("xdrfthreads",cl::desc("Cross-check the instructions around each nDRF region on this many threads"),
+                                           cl::init(1));
+
 // CRA: Conflict resolution addition
 static cl::opt<bool> conflictNDRF("ndrfconflict",cl::desc("Resolve conflicts by putting affected instructions in enclave nDRF regions"));
 
@@ -132,11 +145,11 @@ struct nDRFRegion {
 
     SmallPtrSet<Instruction*,2> beginsAt;
     SmallPtrSet<Instruction*,2> endsAt;
-    SmallPtrSet<Instruction*,128> containedInstructions;
+    SharedPathSet containedInstructions;
     SmallPtrSet<nDRFRegion*,2> precedingRegions;
     SmallPtrSet<nDRFRegion*,2> followingRegions;
-    map<nDRFRegion*,SmallPtrSet<Instruction*,16> > precedingInstructions;
-    map<nDRFRegion*,SmallPtrSet<Instruction*,16> > followingInstructions;
+    map<nDRFRegion*,SharedPathSet> precedingInstructions;
+    map<nDRFRegion*,SharedPathSet> followingInstructions;
     SmallPtrSet<nDRFRegion*,2> synchsWith;
 
     //Format: <PrecedingInst,FollowingInst>
@@ -156,19 +169,17 @@ struct nDRFRegion {
     set<pair<Instruction*,pair<nDRFRegion*,Instruction*> > > resolvedTowardsDRF;
     bool resolved = false; // True iff the region was created to resolve a conflict
 
-    SmallPtrSet<Instruction*,128> getPrecedingInsts() {
-        SmallPtrSet<Instruction*,128> toReturn;
+    PathSet getPrecedingInsts() {
+        PathSet toReturn;
         for (nDRFRegion* region : precedingRegions)
-            toReturn.insert(precedingInstructions[region].begin(),
-                            precedingInstructions[region].end());
+            toReturn |= precedingInstructions[region].get();
         return toReturn;
     }
     
-    SmallPtrSet<Instruction*,128> getFollowingInsts() {
-        SmallPtrSet<Instruction*,128> toReturn;
+    PathSet getFollowingInsts() {
+        PathSet toReturn;
         for (nDRFRegion* region : followingRegions)
-            toReturn.insert(followingInstructions[region].begin(),
-                            followingInstructions[region].end());
+            toReturn |= followingInstructions[region].get();
         return toReturn;
     }
 };
@@ -180,13 +191,15 @@ struct xDRFRegion {
     }
     int ID;
 
-    SmallPtrSet<Instruction*,128> containedInstructions;
+    SharedPathSet containedInstructions;
     SmallPtrSet<nDRFRegion*,2> enclaveNDRFs;
     SmallPtrSet<nDRFRegion*,2> precedingNDRFs;
     SmallPtrSet<nDRFRegion*,2> followingNDRFs;
 
     //contains all XDRFs that have enclave nDRFs that share an synch variable with an enclave nDRF in this region
     SmallPtrSet<xDRFRegion*,2> relatedXDRFs;
+    //The same for xDRFs that are related, directly or through other related xDRFs
+    int relatedID=-1;
     
     //Conflict between this xDRF region and another that prevents them from being merged
     //Also has the nDRF region separating them
@@ -198,11 +211,10 @@ struct xDRFRegion {
     bool startHere=false;
 
     //Returns all instructions contained in this xDRF or any related xDRF
-    SmallPtrSet<Instruction*,128> getAssociatedInstructions() {
-        SmallPtrSet<Instruction*,128> toReturn;
-        toReturn.insert(containedInstructions.begin(),containedInstructions.end());
+    PathSet getAssociatedInstructions() {
+        PathSet toReturn = containedInstructions.get();
         for (xDRFRegion* region : relatedXDRFs)
-            toReturn.insert(region->containedInstructions.begin(),region->containedInstructions.end());    
+            toReturn |= region->containedInstructions.get();
         return toReturn;
     }
     
@@ -257,7 +269,6 @@ struct xDRFRegion {
     }
 };
 
-
 namespace {
 
     struct XDRFExtension : public ModulePass {
@@ -268,11 +279,14 @@ namespace {
 
     public:
         virtual void getAnalysisUsage(AnalysisUsage &AU) const{
+            AU.addRequired<CallTargetIndexPass>();
             AU.addRequired<AAResultsWrapperPass>();
             AU.addRequired<AssumptionCacheTracker>();
             AU.addRequired<TargetLibraryInfoWrapperPass>();
             AU.addRequired<SynchPointDelim>();
             AU.addRequired<ThreadDependence>();
+            AU.addRequired<ThreadSharing>();
+            AU.addRequired<AAResultsCache>();
             AU.addRequired<ScalarEvolutionWrapperPass>();
             //AU.addRequired<DependenceAnalysis>(); // LDA
             AU.addUsedIfAvailable<WPAPass>();
@@ -281,8 +295,20 @@ namespace {
       
         AliasCombiner *aacombined;
 
+        //Shared index of what each call site may call
+        CallTargetIndex *callTargets;
+
+        //The path sets of the regions are interned in the same pool as those
+        //of the synch points they are built from
+        PathSetPool *pathSets;
+        const InstructionNumbering *instNumbering;
+
         virtual bool runOnModule(Module &M) {
+            callTargets = &getAnalysis<CallTargetIndexPass>().getIndex();
             SynchPointDelim &syncdelimited  = getAnalysis<SynchPointDelim>();
+            pathSets = &syncdelimited.pathSetPool;
+            instNumbering = &syncdelimited.instNumbering;
+            buildAccessTable();
             VERBOSE_PRINT("Setting up nDRF regions\n");
             setupNDRFRegions(syncdelimited);
             printnDRFRegionGraph(M);
@@ -290,11 +316,7 @@ namespace {
             aacombined = new AliasCombiner(&M,!skipUseChainAliasing,this,ALIASLEVEL);
             //aacombined->addAliasResult(&aa);
             VERBOSE_PRINT("Determining enclaveness of nDRF regions\n");
-            for (nDRFRegion * region : nDRFRegions)
-                if (region->startHere) {
-                    VERBOSE_PRINT("Starting from region: " << region->ID << "\n");
-                    extendDRFRegion(region);
-                }
+            extendDRFRegions();
             VERBOSE_PRINT("Forming xDRF regions\n");
             for (nDRFRegion * region : nDRFRegions)
                 if (region->startHere) {
@@ -311,14 +333,23 @@ namespace {
                 // }
             }
             setupRelatedXDRFs();
+            buildRegionIndex();
             printInfo();
+            crossCheckPool.stop();
+            delete aacombined;
+            aacombined = NULL;
             return false;
         }
 
         SmallPtrSet<nDRFRegion*,4> nDRFRegions;
         SmallPtrSet<xDRFRegion*,6> xDRFRegions;
 
-        SmallPtrSet<Instruction*,128> instructionsInNDRF;
+        //The region of each numbered instruction by ID, or NULL. An
+        //instruction in several regions maps to the one with the lowest ID
+        vector<xDRFRegion*> xDRFRegionOfID;
+        vector<nDRFRegion*> nDRFRegionOfID;
+
+        PathSet instructionsInNDRF;
 
         // TODO: Move to private?
         // CRA: Conflict resolution addition
@@ -339,7 +370,9 @@ namespace {
                 newNDRF->enclave = true;
                 newNDRF->beginsAt.insert(conflict);
                 newNDRF->endsAt.insert(conflict);
-                newNDRF->containedInstructions.insert(conflict);
+                PathSet conflictSet(instNumbering);
+                conflictSet.insert(conflict);
+                newNDRF->containedInstructions=pathSets->intern(conflictSet);
                 resolvedNDRFs[conflict] = newNDRF;
             }
             return resolvedNDRFs[conflict];
@@ -347,30 +380,17 @@ namespace {
 
         void pruneSurroundingsFromNDRFs() {
             VERBOSE_PRINT("Enabled assumed ndrf no alias assumption\n");
-            for (nDRFRegion* region : nDRFRegions) {
-                for (Instruction* inst : region->containedInstructions) {
-                    instructionsInNDRF.insert(inst);
-                }
-            }
+            for (nDRFRegion* region : nDRFRegions)
+                instructionsInNDRF |= region->containedInstructions.get();
             VERBOSE_PRINT(instructionsInNDRF.size() << " instructions will be ignored during collision detection\n");
             for (nDRFRegion* region : nDRFRegions) {
                 for (nDRFRegion* regionto : region->precedingRegions) {
-                    for (auto iter = region->precedingInstructions[regionto].begin();
-                         iter != region->precedingInstructions[regionto].end();) {
-                        Instruction* toDelete = *(iter++);
-                        if (instructionsInNDRF.count(toDelete) > 0) {
-                            region->precedingInstructions[regionto].erase(toDelete);
-                        }
-                    }
+                    PathSet pruned = region->precedingInstructions[regionto].get();
+                    region->precedingInstructions[regionto] = pathSets->intern(pruned.subtract(instructionsInNDRF));
                 }
                 for (nDRFRegion* regionto : region->followingRegions) {
-                    for (auto iter = region->followingInstructions[regionto].begin();
-                         iter != region->followingInstructions[regionto].end();) {
-                        Instruction* toDelete = *(iter++);
-                        if (instructionsInNDRF.count(toDelete) > 0) {
-                            region->followingInstructions[regionto].erase(toDelete);
-                        }
-                    }
+                    PathSet pruned = region->followingInstructions[regionto].get();
+                    region->followingInstructions[regionto] = pathSets->intern(pruned.subtract(instructionsInNDRF));
                 }
             }
         }
@@ -409,19 +429,19 @@ namespace {
                             nDRFRegion *regofpoint=regionOfPoint[pred];
                             if (regofpoint) {
                                 LIGHT_PRINT("Which already had a region, setting up pred/follow towards " << regofpoint->ID << "\n");
-                                newRegion->precedingInstructions[regofpoint].insert(entry->precedingInsts[pred].begin(),
-                                                                                    entry->precedingInsts[pred].end());
+                                newRegion->precedingInstructions[regofpoint] =
+                                    pathSets->unite(newRegion->precedingInstructions[regofpoint],entry->precedingInsts[pred]);
                                 LIGHT_PRINT("Added " << newRegion->precedingInstructions[regofpoint].size() << " preceding instructions\n");
                                 
-                                regofpoint->followingInstructions[newRegion].insert(entry->precedingInsts[pred].begin(),
-                                                                                    entry->precedingInsts[pred].end());
+                                regofpoint->followingInstructions[newRegion] =
+                                    pathSets->unite(regofpoint->followingInstructions[newRegion],entry->precedingInsts[pred]);
                                 LIGHT_PRINT("Added " << regofpoint->followingInstructions[newRegion].size() << " following instructions\n");
                                 newRegion->precedingRegions.insert(regofpoint);
                                 regofpoint->followingRegions.insert(newRegion);
                             }
                         } else {
-                            newRegion->precedingInstructions[NULL].insert(entry->precedingInsts[NULL].begin(),
-                                                                          entry->precedingInsts[NULL].end());
+                            newRegion->precedingInstructions[NULL] =
+                                pathSets->unite(newRegion->precedingInstructions[NULL],entry->precedingInsts[NULL]);
                             newRegion->precedingRegions.insert(NULL);
                         }
                     }
@@ -438,18 +458,18 @@ namespace {
                             nDRFRegion *regofpoint=regionOfPoint[follow];
                             if (regofpoint) {
                                 LIGHT_PRINT("Which already had a region, setting up pred/follow towards " << regofpoint->ID << "\n");
-                                newRegion->followingInstructions[regofpoint].insert(exit->followingInsts[follow].begin(),
-                                                                                    exit->followingInsts[follow].end());
+                                newRegion->followingInstructions[regofpoint] =
+                                    pathSets->unite(newRegion->followingInstructions[regofpoint],exit->followingInsts[follow]);
                                 LIGHT_PRINT("Added " << newRegion->followingInstructions[regofpoint].size() << " following instructions\n");
-                                regofpoint->precedingInstructions[newRegion].insert(exit->followingInsts[follow].begin(),
-                                                                                    exit->followingInsts[follow].end());
+                                regofpoint->precedingInstructions[newRegion] =
+                                    pathSets->unite(regofpoint->precedingInstructions[newRegion],exit->followingInsts[follow]);
                                 LIGHT_PRINT("Added " << regofpoint->precedingInstructions[newRegion].size() << " preceding instructions\n");
                                 newRegion->followingRegions.insert(regofpoint);
                                 regofpoint->precedingRegions.insert(newRegion);
                             }
                         } else {
-                            newRegion->followingInstructions[NULL].insert(exit->followingInsts[NULL].begin(),
-                                                                          exit->followingInsts[NULL].end());
+                            newRegion->followingInstructions[NULL] =
+                                pathSets->unite(newRegion->followingInstructions[NULL],exit->followingInsts[NULL]);
                             newRegion->followingRegions.insert(NULL);
                         }
                     }
@@ -469,8 +489,8 @@ namespace {
                             //following regions that are not exit points in this region
                             (!(critRegion->exitSynchPoints.count(in) != 0) || critRegion->exitSynchPoints.count(after) != 0))
                             {
-                            newRegion->containedInstructions.insert(in->followingInsts[after].begin(),
-                                                                    in->followingInsts[after].end());
+                            newRegion->containedInstructions =
+                                pathSets->unite(newRegion->containedInstructions,in->followingInsts[after]);
                         }
                     }
                 }
@@ -501,98 +521,411 @@ namespace {
             }
         }
 
-        //Utility: Returns the proper type of a pointer type
-        Type *getTypeOfPointerType(Type *ptr) {
-            while (PointerType *p = dyn_cast<PointerType>(ptr))
-                ptr = p->getElementType();
-            return ptr;
-        }
-        
+        //Obtains the set of functions that can be immediately called when
+        //executing inst
         SmallPtrSet<Function*,1> getCalledFuns(Instruction *inst) {
             SmallPtrSet<Function*,1> toReturn;
-            SmallPtrSet<Value*,8> alreadyVisited;
-            if (isCallSite(inst)) {
-                CallSite call = CallSite(inst);
-                Value *calledValue = call.getCalledValue();
-                //Rather than doing this: would it be possible with a decent AA to just
-                //check if the value aliases with each function in the module?
-                deque<Value*> calledValues;
-                calledValues.push_back(calledValue);
-                while (!calledValues.empty()) {
-                    Value *nextValue = calledValues.front();
-                    calledValues.pop_front();
-                    nextValue = nextValue->stripInBoundsConstantOffsets();
-                    if (alreadyVisited.count(nextValue) != 0)
+            for (Function *fun : callTargets->getCalledFuns(inst))
+                if (noAnalyzeFunctions.count(fun->getName()) == 0)
+                    toReturn.insert(fun);
+            return toReturn;
+        }
+
+        //Returns the memory inst may access as CallTargetIndex::MemoryEffects bits.
+        //Stores write, loads read and calls access whatever their callees may
+        unsigned computeAccessEffects(Instruction *inst) {
+            unsigned effects = CallTargetIndex::NoMemoryEffects;
+            if (isa<StoreInst>(inst))
+                effects = CallTargetIndex::WritesMemory;
+            else if (isa<LoadInst>(inst))
+                effects = CallTargetIndex::ReadsMemory;
+            else
+                for (Function *fun : getCalledFuns(inst))
+                    effects |= callTargets->getMemoryEffects(fun);
+            return effects;
+        }
+
+        //The access effects of every numbered instruction by ID, and the
+        //numbered instructions split by the kind of access they make
+        vector<unsigned> accessEffectsOfID;
+        PathSet writingInsts;
+        PathSet readOnlyInsts;
+        PathSet accessingInsts;
+        PathSet noInsts;
+
+        void buildAccessTable() {
+            accessEffectsOfID.assign(instNumbering->size(),CallTargetIndex::NoMemoryEffects);
+            writingInsts = PathSet(instNumbering);
+            readOnlyInsts = PathSet(instNumbering);
+            noInsts = PathSet(instNumbering);
+            for (unsigned ID = 0; ID < instNumbering->size(); ++ID) {
+                Instruction *inst = instNumbering->getInstruction(ID);
+                unsigned effects = accessEffectsOfID[ID] = computeAccessEffects(inst);
+                if ((effects & CallTargetIndex::WritesMemory) != 0)
+                    writingInsts.insert(inst);
+                else if (effects != CallTargetIndex::NoMemoryEffects)
+                    readOnlyInsts.insert(inst);
+            }
+            accessingInsts = writingInsts;
+            accessingInsts |= readOnlyInsts;
+            VERBOSE_PRINT(writingInsts.size() << " instructions may write and " << readOnlyInsts.size() << " only read, of "
+                          << instNumbering->size() << "\n");
+        }
+
+        unsigned getAccessEffects(Instruction *inst) {
+            if (instNumbering->hasID(inst))
+                return accessEffectsOfID[instNumbering->getID(inst)];
+            return computeAccessEffects(inst);
+        }
+
+        //The accesses of an interned path set, bucketed on the abstract
+        //objects they may refer to. Accesses whose objects are not bounded
+        //are kept apart, they are candidates for everything
+        struct ConflictIndex {
+            PathSet unbounded;
+            DenseMap<Value*,PathSet> accessesOf;
+        };
+        map<const PathSet*,ConflictIndex> conflictIndexDynamic;
+
+        const ConflictIndex &getConflictIndex(const PathSet &insts) {
+            auto found = conflictIndexDynamic.find(&insts);
+            if (found != conflictIndexDynamic.end())
+                return found->second;
+            ConflictIndex &index = conflictIndexDynamic[&insts];
+            index.unbounded = PathSet(instNumbering);
+            for (Instruction *inst : insts) {
+                const SmallPtrSet<Value*,4> &objects = aacombined->getAccessedObjects(inst);
+                if (objects.count(NULL) != 0) {
+                    index.unbounded.insert(inst);
+                    continue;
+                }
+                for (Value *object : objects) {
+                    auto bucket = index.accessesOf.find(object);
+                    if (bucket == index.accessesOf.end())
+                        bucket = index.accessesOf.insert(make_pair(object,PathSet(instNumbering))).first;
+                    bucket->second.insert(inst);
+                }
+            }
+            VERBOSE_PRINT("Bucketed " << insts.size() << " instructions on " << index.accessesOf.size() << " objects, "
+                          << index.unbounded.size() << " are unbounded\n");
+            return index;
+        }
+
+        //The instructions of insts that inst has to be checked against for
+        //conflicts. Unless conflicts are bucketed that is all of them
+        PathSet getConflictCandidates(Instruction *inst, SharedPathSet insts) {
+            if (!bucketConflicts || !aacombined->canSeparateAccesses() || insts.empty())
+                return insts.get();
+            const SmallPtrSet<Value*,4> &objects = aacombined->getAccessedObjects(inst);
+            if (objects.count(NULL) != 0)
+                return insts.get();
+            const ConflictIndex &index = getConflictIndex(insts.get());
+            PathSet candidates = index.unbounded;
+            for (Value *object : objects) {
+                auto bucket = index.accessesOf.find(object);
+                if (bucket != index.accessesOf.end())
+                    candidates |= bucket->second;
+            }
+            return candidates;
+        }
+
+        //Dense IDs of the abstract objects, for the summaries
+        DenseMap<Value*,unsigned> objectIDs;
+
+        unsigned getObjectID(Value *object) {
+            auto found = objectIDs.find(object);
+            if (found != objectIDs.end())
+                return found->second;
+            unsigned ID = objectIDs.size();
+            return objectIDs[object]=ID;
+        }
+
+        //The abstract objects the accesses of an interned path set may write,
+        //and those that are only read. The unbounded flags stand in for
+        //accesses whose objects are not bounded
+        struct AccessSummary {
+            BitVector writes;
+            BitVector reads;
+            bool unboundedWrites=false;
+            bool unboundedReads=false;
+        };
+        map<const PathSet*,AccessSummary> accessSummaryDynamic;
+
+        const AccessSummary &getAccessSummary(const PathSet &insts) {
+            auto found = accessSummaryDynamic.find(&insts);
+            if (found != accessSummaryDynamic.end())
+                return found->second;
+            AccessSummary &summary = accessSummaryDynamic[&insts];
+            for (Instruction *inst : insts) {
+                unsigned effects = getAccessEffects(inst);
+                if (effects == CallTargetIndex::NoMemoryEffects)
+                    continue;
+                bool writes = (effects & CallTargetIndex::WritesMemory) != 0;
+                BitVector &objectsOfKind = writes ? summary.writes : summary.reads;
+                for (Value *object : aacombined->getAccessedObjects(inst)) {
+                    if (!object) {
+                        (writes ? summary.unboundedWrites : summary.unboundedReads) = true;
                         continue;
-                    alreadyVisited.insert(nextValue);
-                    //Try to resolve the value into a function
-                    if (auto fun = dyn_cast<Function>(nextValue)) {
-                        if (noAnalyzeFunctions.count(fun->getName()) == 0)
-                            toReturn.insert(fun);
-                    }
-                    //Since we are dealing with functions, only a few
-                    //instructions should be possible
-                    else if (auto phi = dyn_cast<PHINode>(nextValue))
-                        for (int i = 0; i < phi->getNumIncomingValues(); ++i)
-                            calledValues.push_back(phi->getIncomingValue(i));
-                    else if (dyn_cast<Instruction>(nextValue) && isCallSite(dyn_cast<Instruction>(nextValue))) {
-                        //We get the return from a function, find all values
-                        //that could be returned from that function
-                        //and toss them onto the queue
-                        //TODO: Do we need to handle the case where functions are
-                        //returned recursively?
-                        //For now, ignore it
-                        SmallPtrSet<Function*,1> calledFuns = getCalledFuns(dyn_cast<Instruction>(nextValue));
-                        for (Function* fun : calledFuns) {
-                            for (auto instb = inst_begin(fun);
-                                 instb != inst_end(fun); ++instb) {
-                                if (auto returninst = dyn_cast<ReturnInst>(&*instb)) {
-                                    if (Value* returnval = returninst->getReturnValue())
-                                        calledValues.push_back(returnval);
-                                }
-                            }
-                        }
-                    }
-                
-                    //Here we pick apart data structures
-                    else if (auto gep = dyn_cast<GetElementPtrInst>(nextValue)) {
-                        //Any remaining gep must, by definition, have a dynamic index
-                        //So we just resolve the value that is gepped from
-                        calledValues.push_back(gep->getPointerOperand());
                     }
-                    else if (auto load = dyn_cast<LoadInst>(nextValue)) {
-                        calledValues.push_back(load->getPointerOperand());
-                    }
-                    else if (auto arg = dyn_cast<Argument>(nextValue)) {
-                        //Track values from the callsites
-                        for (auto use = arg->getParent()->users().begin();
-                             use != arg->getParent()->users().end();
-                             ++use) {
-                            if (dyn_cast<Instruction>(*use) && isCallSite(dyn_cast<Instruction>(*use))) {
-                                CallSite callsite(*use);
-                                calledValues.push_back(callsite.getArgOperand(arg->getArgNo()));
-                            }
-                        }
-                    }
-                    else if (auto glob = dyn_cast<GlobalVariable>(nextValue)) {
-                        //at this point we can basically give up, any function
-                        //that has its adress taken can be used here
-                        for (Function &fun : inst->getParent()->getParent()->getParent()->getFunctionList()) {
-                            if (fun.hasAddressTaken()) {
-                                if (fun.getFunctionType() == dyn_cast<FunctionType>(getTypeOfPointerType(glob->getType()))) {
-                                    toReturn.insert(&fun);
-                                }
-                            }
-                        }
-                    } else {
-                        //We failed to resolve function to be called. Print diagnostic message
-                        // VERBOSE_PRINT("Failed to resolve value: " << *nextValue
-                        //               << "\nwhich has type: " << typeid(*nextValue).name()
-                        //               << "\nwhile resolving called functions.\n");
-                    }                    
+                    unsigned ID = getObjectID(object);
+                    if (ID >= objectsOfKind.size())
+                        objectsOfKind.resize(objectIDs.size());
+                    objectsOfKind.set(ID);
                 }
             }
-            return toReturn;
+            return summary;
+        }
+
+        //Whether some object of one kind may be one of the other
+        static bool overlaps(const BitVector &objects1, bool unbounded1,
+                             const BitVector &objects2, bool unbounded2) {
+            if (unbounded1 && (unbounded2 || objects2.any()))
+                return true;
+            if (unbounded2 && objects1.any())
+                return true;
+            return objects1.anyCommon(objects2);
+        }
+
+        //Whether an instruction of before may conflict with one of after. A
+        //false answer means no pair of them needs checking. Specialized
+        //checks only consider reads in before against writes in after, as
+        //MAYCONFLICT_SPECC does. The summaries can only rule pairs out when an
+        //asked alias tier separates the objects they are built from
+        bool segmentsMayConflict(SharedPathSet before, SharedPathSet after, bool specialized) {
+            if (!bucketConflicts || !aacombined->canSeparateAccesses())
+                return true;
+            if (before.empty() || after.empty())
+                return false;
+            const AccessSummary &summary1 = getAccessSummary(before.get());
+            const AccessSummary &summary2 = getAccessSummary(after.get());
+            if (overlaps(summary1.reads,summary1.unboundedReads,summary2.writes,summary2.unboundedWrites))
+                return true;
+            if (specialized)
+                return false;
+            return overlaps(summary1.writes,summary1.unboundedWrites,summary2.writes,summary2.unboundedWrites) ||
+                overlaps(summary1.writes,summary1.unboundedWrites,summary2.reads,summary2.unboundedReads);
+        }
+
+        //One instruction of the cross-check around an nDRF region, with the
+        //instructions it is checked against
+        struct CrossCheck {
+            enum Kind {
+                //A preceding DRF instruction against the following ones
+                PrecedingFollowing,
+                //A preceding DRF instruction against a following nDRF
+                PrecedingFollowingNDRF,
+                //An instruction of the nDRF against the preceding ones
+                ContainedPreceding,
+                //An instruction of the nDRF against the following ones
+                ContainedFollowing
+            };
+
+            CrossCheck(Kind kind, Instruction *inst, nDRFRegion *region, SharedPathSet against) :
+                kind(kind), inst(inst), region(region), against(against) {}
+
+            Kind kind;
+            Instruction *inst;
+            //The nDRF the conflicts are towards, if any
+            nDRFRegion *region;
+            SharedPathSet against;
+        };
+
+        //The instructions that can conflict with check.inst by the kinds of
+        //access alone, as MAYCONFLICT and MAYCONFLICT_SPECC decide them
+        const PathSet &getConflictingKinds(const CrossCheck &check) {
+            unsigned effects = getAccessEffects(check.inst);
+            bool writes = (effects & CallTargetIndex::WritesMemory) != 0;
+            if (effects == CallTargetIndex::NoMemoryEffects)
+                return noInsts;
+            if (check.kind == CrossCheck::PrecedingFollowing || !useSpecializedCrossCheck)
+                return writes ? accessingInsts : writingInsts;
+            //Specialized checks only pair a read before a write
+            if (check.kind == CrossCheck::ContainedPreceding)
+                return writes ? readOnlyInsts : noInsts;
+            return writes ? noInsts : writingInsts;
+        }
+
+        //Collects the instructions check.inst conflicts with. Stops when
+        //cancelled is set, and sets it on the first conflict if witnessOnly
+        void runCrossCheck(const CrossCheck &check, vector<Instruction*> &conflicting,
+                           atomic<bool> &cancelled, bool witnessOnly) {
+            PathSet candidates = getConflictCandidates(check.inst,check.against);
+            //Read-read and no-memory pairs are dropped with one intersection
+            candidates.intersect(getConflictingKinds(check));
+            vector<Instruction*> ordered(candidates.begin(),candidates.end());
+            //Only the first conflict matters, so the likely ones go first.
+            //Otherwise every candidate is checked, and SVF is asked about
+            //all of them in one batch
+            if (witnessOnly)
+                stable_sort(ordered.begin(),ordered.end(),
+                            [&](Instruction *a, Instruction *b) {
+                                return getConflictLikelihoodRank(check.inst,a) < getConflictLikelihoodRank(check.inst,b);
+                            });
+            else
+                aacombined->prefetchSVFResults(check.inst,ordered);
+            for (Instruction * other : ordered) {
+                if (cancelled)
+                    return;
+                bool found = false;
+                switch (check.kind) {
+                case CrossCheck::PrecedingFollowing:
+                    //Comparing instructions to themselves, in case of loops, is perfectly fine
+                    found = MAYCONFLICT_DRF_DRF(check.inst,other);
+                    break;
+                case CrossCheck::ContainedPreceding:
+                    found = MAYCONFLICT_DRF_NDRF(other,check.inst);
+                    break;
+                default:
+                    found = MAYCONFLICT_DRF_NDRF(check.inst,other);
+                    break;
+                }
+                if (!found)
+                    continue;
+                conflicting.push_back(other);
+                if (witnessOnly) {
+                    cancelled = true;
+                    return;
+                }
+            }
+        }
+
+        //The workers are started for the first region that needs them and
+        //kept for the rest
+        WorkerPool crossCheckPool;
+
+        //Runs the checks, on several threads with -xdrfthreads. The
+        //conflicts of each check are kept apart so they can be recorded in
+        //order afterwards
+        vector<vector<Instruction*> > runCrossChecks(const vector<CrossCheck> &checks, bool witnessOnly) {
+            vector<vector<Instruction*> > conflicting(checks.size());
+            //Checks that decide alone start with the likely conflicting
+            //instructions
+            vector<unsigned> order(checks.size());
+            for (unsigned i = 0; i < checks.size(); ++i)
+                order[i] = i;
+            if (witnessOnly)
+                stable_sort(order.begin(),order.end(),
+                            [&](unsigned a, unsigned b) {
+                                return getConflictLikelihoodRank(NULL,checks[a].inst) < getConflictLikelihoodRank(NULL,checks[b].inst);
+                            });
+            atomic<bool> cancelled(false);
+            atomic<unsigned> nextCheck(0);
+            auto worker = [&]() {
+                for (unsigned i = nextCheck++; i < checks.size() && !cancelled; i = nextCheck++)
+                    runCrossCheck(checks[order[i]],conflicting[order[i]],cancelled,witnessOnly);
+            };
+            if (crossCheckThreads <= 1 || checks.size() <= 1) {
+                worker();
+                return conflicting;
+            }
+
+            //The conflict indices are built up front, workers only look them
+            //up. The alias combiner guards its own caches
+            if (bucketConflicts && aacombined->canSeparateAccesses())
+                for (const CrossCheck &check : checks)
+                    if (!check.against.empty())
+                        getConflictIndex(check.against.get());
+
+            crossCheckPool.start(crossCheckThreads);
+            crossCheckPool.run(worker);
+            return conflicting;
+        }
+
+        //Instructions already found in a conflict, they are likely to be
+        //in the next one too
+        SmallPtrSet<Instruction*,16> conflictWitnesses;
+
+        //Lower ranks are tried first when one conflict decides. Instructions
+        //seen in a conflict before come first, then those sharing an
+        //abstract object with inst (if given), then writes before reads
+        unsigned getConflictLikelihoodRank(Instruction *inst, Instruction *other) {
+            unsigned rank = 0;
+            if (conflictWitnesses.count(other) == 0)
+                rank += 4;
+            if (inst && !shareAccessedObject(inst,other))
+                rank += 2;
+            if ((getAccessEffects(other) & CallTargetIndex::WritesMemory) == 0)
+                rank += 1;
+            return rank;
+        }
+
+        bool shareAccessedObject(Instruction *inst, Instruction *other) {
+            const SmallPtrSet<Value*,4> &objects = aacombined->getAccessedObjects(inst);
+            for (Value *object : aacombined->getAccessedObjects(other))
+                if (object && objects.count(object) != 0)
+                    return true;
+            return false;
+        }
+
+        //Records a conflict found by check, returns true if it keeps the
+        //region from being enclave
+        bool recordConflict(nDRFRegion *regionToExtend, const CrossCheck &check, Instruction *other) {
+            switch (check.kind) {
+            case CrossCheck::PrecedingFollowing: {
+                Instruction *instPre = check.inst, *instAfter = other;
+                if (!conflictNDRF) {
+                    if (!skipConflictStore)
+                        regionToExtend->conflictsBetweenDRF.insert(make_pair(instPre,instAfter));
+                    DEBUG_PRINT("Found conflict between preceding and following DRF regions\n");
+                    return true;
+                }
+                // CRA
+                nDRFRegion *resolvedNDRFPre = getResolvedNDRF(instPre);
+                nDRFRegion *resolvedNDRFAfter = getResolvedNDRF(instAfter);
+                if (!skipConflictStore) {
+                    pair<Instruction*,Instruction*> conflpair = make_pair(instPre,instAfter);
+                    resolvedNDRFPre->resolvedBetweenDRF.insert(conflpair);
+                    resolvedNDRFAfter->resolvedBetweenDRF.insert(conflpair);
+                    regionToExtend->resolvedBetweenDRF.insert(conflpair);
+                }
+                DEBUG_PRINT("Found and resolved conflict between preceding and following DRF regions\n");
+                //Suppress setting conflict
+                return false;
+            }
+            case CrossCheck::PrecedingFollowingNDRF:
+            case CrossCheck::ContainedPreceding: {
+                //Either our preceding instruction towards a following nDRF,
+                //or our nDRF towards a preceding instruction
+                Instruction *instPre = check.kind == CrossCheck::ContainedPreceding ? other : check.inst;
+                Instruction *instIn = check.kind == CrossCheck::ContainedPreceding ? check.inst : other;
+                if (!conflictNDRF) {
+                    if (!skipConflictStore)
+                        regionToExtend->conflictsTowardsDRF.insert(make_pair(instPre,make_pair(check.region,instIn)));
+                    DEBUG_PRINT("Found conflict between " << (check.kind == CrossCheck::ContainedPreceding ? "nDRF region and preceding DRF regions\n" : "preceding DRF and following nDRF regions\n"));
+                    return true;
+                }
+                // CRA
+                nDRFRegion *resolvedNDRFPre = getResolvedNDRF(instPre);
+                if (!skipConflictStore) {
+                    pair<Instruction*,pair<nDRFRegion*,Instruction*> > conflpair = make_pair(instPre,make_pair(check.region,instIn));
+                    resolvedNDRFPre->resolvedTowardsDRF.insert(conflpair);
+                    regionToExtend->resolvedTowardsDRF.insert(conflpair);
+                }
+                DEBUG_PRINT("Found and resolved conflict between " << (check.kind == CrossCheck::ContainedPreceding ? "nDRF region and preceding DRF regions\n" : "preceding DRF and following nDRF regions\n"));
+                //Suppress setting conflict
+                return false;
+            }
+            case CrossCheck::ContainedFollowing:
+            default: {
+                Instruction *instIn = check.inst, *instAfter = other;
+                if (!conflictNDRF) {
+                    if (!skipConflictStore)
+                        regionToExtend->conflictsTowardsDRF.insert(make_pair(instAfter,make_pair(regionToExtend,instIn)));
+                    DEBUG_PRINT("Found conflict between nDRF region and following DRF regions\n");
+                    return true;
+                }
+                // CRA
+                nDRFRegion *resolvedNDRFAfter = getResolvedNDRF(instAfter);
+                if (!skipConflictStore) {
+                    pair<Instruction*,pair<nDRFRegion*,Instruction*> > conflpair = make_pair(instAfter,make_pair(regionToExtend,instIn));
+                    resolvedNDRFAfter->resolvedTowardsDRF.insert(conflpair);
+                    regionToExtend->resolvedTowardsDRF.insert(conflpair);
+                }
+                DEBUG_PRINT("Found and resolved conflict between nDRF region and following DRF regions\n");
+                //Suppress setting conflict
+                return false;
+            }
+            }
         }
 
         // bool MAYCONFLICT_NDRF_DRF(Instruction* X, Instruction* Y) {
@@ -619,56 +952,21 @@ namespace {
 
         bool MAYCONFLICT_SPECC(Instruction* X, Instruction* Y) {
             LIGHT_PRINT("Checking if " << *X << " conflicts with " << *Y << "\n");
+            unsigned Xeffects = getAccessEffects(X);
+            unsigned Yeffects = getAccessEffects(Y);
+            //If either instruction cannot access memory, there cannot be a conflict
+            if (Xeffects == CallTargetIndex::NoMemoryEffects) {
+                LIGHT_PRINT("Decided there was no conflict since " << *X << " does not access memory\n");
+                return false;
+            }
+            if (Yeffects == CallTargetIndex::NoMemoryEffects) {
+                LIGHT_PRINT("Decided there was no conflict since " << *Y << " does not access memory\n");
+                return false;
+            }
             //True if X is a fun that could write or a store
-            bool XcanBeWritingFun=false;
+            bool XcanBeWritingFun=(Xeffects & CallTargetIndex::WritesMemory) != 0;
             //True if Y is a fun that could write or a store
-            bool YcanBeWritingFun=false;
-
-            //True if X is not a store or a load and only calls functions that do not access memory
-            bool XdoesNotAccessMemory=false;
-            //True if Y is not a store and only calls functions that do not access memory
-            bool YdoesNotAccessMemory=false;
-            
-            if (!isa<StoreInst>(X)) {
-                if (!isa<LoadInst>(X))
-                    XdoesNotAccessMemory=true;
-                for (Function *fun : getCalledFuns(X)) {
-                    if (!fun->doesNotAccessMemory()) {
-                        XdoesNotAccessMemory=false;
-                    }
-                    if (!fun->onlyReadsMemory()) {
-                        XcanBeWritingFun=true;
-                        XdoesNotAccessMemory=false;
-                        break;
-                    }
-                }
-                //If either instruction cannot access memory, there cannot be a conflict
-                if (XdoesNotAccessMemory) {
-                    LIGHT_PRINT("Decided there was no conflict since " << *X << " does not access memory\n");
-                    return false;
-                }
-            } else
-                XcanBeWritingFun=true;
-            if (!isa<StoreInst>(Y)) {
-                if (!isa<LoadInst>(Y))
-                    YdoesNotAccessMemory=true;
-                for (Function *fun : getCalledFuns(Y)) {
-                    if (!fun->doesNotAccessMemory()) {
-                        YdoesNotAccessMemory=false;
-                    }
-                    if (!fun->onlyReadsMemory()) {
-                        YcanBeWritingFun=true;
-                        YdoesNotAccessMemory=false;
-                        break;
-                    }
-                }
-                //If either instruction cannot access memory, there cannot be a conflict
-                if (YdoesNotAccessMemory) {
-                    LIGHT_PRINT("Decided there was no conflict since " << *Y << " does not access memory\n");
-                    return false;
-                }
-            } else
-                YcanBeWritingFun=true;
+            bool YcanBeWritingFun=(Yeffects & CallTargetIndex::WritesMemory) != 0;
 
             //Neither one is a store or writing fun
             if (!XcanBeWritingFun && !YcanBeWritingFun) {
@@ -686,56 +984,21 @@ namespace {
         bool MAYCONFLICT(Instruction* X, Instruction* Y) {
             LIGHT_PRINT("Checking if " << *X << " conflicts with " << *Y << "\n");
             //if (!isa<StoreInst>(X) && !isa<CallInst>(X)) {
+            unsigned Xeffects = getAccessEffects(X);
+            unsigned Yeffects = getAccessEffects(Y);
+            //If either instruction cannot access memory, there cannot be a conflict
+            if (Xeffects == CallTargetIndex::NoMemoryEffects) {
+                LIGHT_PRINT("Decided there was no conflict since " << *X << " does not access memory\n");
+                return false;
+            }
+            if (Yeffects == CallTargetIndex::NoMemoryEffects) {
+                LIGHT_PRINT("Decided there was no conflict since " << *Y << " does not access memory\n");
+                return false;
+            }
             //True if X is a fun that could write or a store
-            bool XcanBeWritingFun=false;
+            bool XcanBeWritingFun=(Xeffects & CallTargetIndex::WritesMemory) != 0;
             //True if Y is a fun that could write or a store
-            bool YcanBeWritingFun=false;
-
-            //True if X is not a store or a load and only calls functions that do not access memory
-            bool XdoesNotAccessMemory=false;
-            //True if Y is not a store and only calls functions that do not access memory
-            bool YdoesNotAccessMemory=false;
-            
-            if (!isa<StoreInst>(X)) {
-                if (!isa<LoadInst>(X))
-                    XdoesNotAccessMemory=true;
-                for (Function *fun : getCalledFuns(X)) {
-                    if (!fun->doesNotAccessMemory()) {
-                        XdoesNotAccessMemory=false;
-                    }
-                    if (!fun->onlyReadsMemory()) {
-                        XcanBeWritingFun=true;
-                        XdoesNotAccessMemory=false;
-                        break;
-                    }
-                }
-                //If either instruction cannot access memory, there cannot be a conflict
-                if (XdoesNotAccessMemory) {
-                    LIGHT_PRINT("Decided there was no conflict since " << *X << " does not access memory\n");
-                    return false;
-                }
-            } else
-                XcanBeWritingFun=true;
-            if (!isa<StoreInst>(Y)) {
-                if (!isa<LoadInst>(Y))
-                    YdoesNotAccessMemory=true;
-                for (Function *fun : getCalledFuns(Y)) {
-                    if (!fun->doesNotAccessMemory()) {
-                        YdoesNotAccessMemory=false;
-                    }
-                    if (!fun->onlyReadsMemory()) {
-                        YcanBeWritingFun=true;
-                        YdoesNotAccessMemory=false;
-                        break;
-                    }
-                }
-                //If either instruction cannot access memory, there cannot be a conflict
-                if (YdoesNotAccessMemory) {
-                    LIGHT_PRINT("Decided there was no conflict since " << *Y << " does not access memory\n");
-                    return false;
-                }
-            } else
-                YcanBeWritingFun=true;
+            bool YcanBeWritingFun=(Yeffects & CallTargetIndex::WritesMemory) != 0;
 
             //Neither one is a store or writing fun
             if (!XcanBeWritingFun && !YcanBeWritingFun) {
@@ -782,180 +1045,324 @@ namespace {
             return true;
         }
         
-        //Returns a pair:
-        //first = instructions to check towards
-        //Second = regions that follow us
-        map<nDRFRegion*,pair<SmallPtrSet<Instruction*,64>, SmallPtrSet<nDRFRegion*,2> > > extendDRFRegionDynamic;
-        pair<SmallPtrSet<Instruction*,64>,SmallPtrSet<nDRFRegion*,2> > extendDRFRegion(nDRFRegion *regionToExtend) {
-            if (extendDRFRegionDynamic.count(regionToExtend) != 0)
-                return extendDRFRegionDynamic[regionToExtend];
-
-            //Obtain what to compare against
-            SmallPtrSet<Instruction*,64> toCompareAgainst;
-            SmallPtrSet<nDRFRegion*,2> followingRegions;
-
-            //Handle end of context
-            if (regionToExtend == NULL)
-                return make_pair(toCompareAgainst,followingRegions);
+        //What an nDRF region hands to the regions before it: the
+        //instructions they must compare against and the nDRFs that follow
+        struct RegionReach {
+            SharedPathSet instructions;
+            SmallPtrSet<nDRFRegion*,2> regions;
+        };
+
+        //Signals and waits are never xDRF, and nothing is compared across them
+        static bool isSignalRegion(nDRFRegion *region) {
+            return region->receivesSignal || region->sendsSignal;
+        }
 
-            VERBOSE_PRINT("Handling region " << regionToExtend->ID << "\n");
-            // VERBOSE_PRINT("  starting in BBs:\n");
-            // for (Instruction *inst: regionToExtend->beginsAt)
-            //     VERBOSE_PRINT("    " << inst->getParent()->getName() << ", " << inst->getFunction()->getName() << "\n");
-            // VERBOSE_PRINT("  ending in BBs:\n");
-            // for (Instruction *inst: regionToExtend->endsAt)
-            //     VERBOSE_PRINT("    " << inst->getParent()->getName() << ", " << inst->getFunction()->getName() << "\n");
-            // VERBOSE_PRINT("  containing "<< regionToExtend->containedInstructions.size() <<"\n");
-            // VERBOSE_PRINT("  with properties: receivesSignal - " << regionToExtend->receivesSignal << ", sendsSignal - " << regionToExtend->sendsSignal << "\n");
-
-            //Handles recursive cases
-            extendDRFRegionDynamic[regionToExtend]=make_pair(toCompareAgainst,followingRegions);
-
-            //Obtain the instructions to compare from regions that follow us
-            for (nDRFRegion * region : regionToExtend->followingRegions) {
-                toCompareAgainst.insert(regionToExtend->followingInstructions[region].begin(),
-                                        regionToExtend->followingInstructions[region].end());
-                followingRegions.insert(region);
-                pair<SmallPtrSet<Instruction*,64>, SmallPtrSet<nDRFRegion*,2> > recursiveCompareAgainst = extendDRFRegion(region);
-                toCompareAgainst.insert(recursiveCompareAgainst.first.begin(),
-                                        recursiveCompareAgainst.first.end());
-                
-                followingRegions.insert(recursiveCompareAgainst.second.begin(),
-                                        recursiveCompareAgainst.second.end());
+        //The regions reached by extending over region, in following or
+        //synching order
+        static void getSuccessorRegions(nDRFRegion *region, vector<nDRFRegion*> &successors) {
+            for (nDRFRegion * following : region->followingRegions)
+                if (following)
+                    successors.push_back(following);
+            successors.insert(successors.end(),region->synchsWith.begin(),region->synchsWith.end());
+            sort(successors.begin(),successors.end(),
+                 [](nDRFRegion *a, nDRFRegion *b) {return a->ID < b->ID;});
+        }
+
+        //The SCCs of the graph of regions, in Tarjan's order: an SCC comes
+        //after all the SCCs it reaches. Edges into signal regions are left out,
+        //those regions hand nothing on, so they never join a cycle
+        void getRegionSCCs(const vector<nDRFRegion*> &regions, vector<vector<nDRFRegion*> > &sccs) {
+            map<nDRFRegion*,unsigned> index, lowlink;
+            unsigned nextIndex = 0;
+            SmallPtrSet<nDRFRegion*,16> onStack;
+            vector<nDRFRegion*> stack;
+            //The region being visited and the next of its successors to visit
+            vector<pair<nDRFRegion*,unsigned> > visiting;
+            map<nDRFRegion*,vector<nDRFRegion*> > successorsOf;
+            for (nDRFRegion * region : regions) {
+                vector<nDRFRegion*> successors;
+                getSuccessorRegions(region,successors);
+                for (nDRFRegion * successor : successors)
+                    if (!isSignalRegion(successor))
+                        successorsOf[region].push_back(successor);
             }
-            
-            //Obtain the instructions to compare from regions that synch with us
-            for (nDRFRegion * region : regionToExtend->synchsWith) {
-                pair<SmallPtrSet<Instruction*,64>, SmallPtrSet<nDRFRegion*,2> > recursiveCompareAgainst = extendDRFRegion(region);
-                followingRegions.insert(region);
-                toCompareAgainst.insert(recursiveCompareAgainst.first.begin(),
-                                        recursiveCompareAgainst.first.end());
-                followingRegions.insert(recursiveCompareAgainst.second.begin(),
-                                        recursiveCompareAgainst.second.end());
-                
+            for (nDRFRegion * root : regions) {
+                if (index.count(root) != 0)
+                    continue;
+                visiting.push_back(make_pair(root,0));
+                while (!visiting.empty()) {
+                    nDRFRegion *region = visiting.back().first;
+                    if (visiting.back().second == 0 && index.count(region) == 0) {
+                        index[region] = lowlink[region] = nextIndex++;
+                        stack.push_back(region);
+                        onStack.insert(region);
+                    }
+                    vector<nDRFRegion*> &successors = successorsOf[region];
+                    if (visiting.back().second < successors.size()) {
+                        nDRFRegion *successor = successors[visiting.back().second++];
+                        if (index.count(successor) == 0)
+                            visiting.push_back(make_pair(successor,0));
+                        else if (onStack.count(successor) != 0)
+                            lowlink[region] = min(lowlink[region],index[successor]);
+                        continue;
+                    }
+                    visiting.pop_back();
+                    if (!visiting.empty())
+                        lowlink[visiting.back().first] = min(lowlink[visiting.back().first],lowlink[region]);
+                    if (lowlink[region] != index[region])
+                        continue;
+                    sccs.push_back(vector<nDRFRegion*>());
+                    nDRFRegion *member;
+                    do {
+                        member = stack.back();
+                        stack.pop_back();
+                        onStack.erase(member);
+                        sccs.back().push_back(member);
+                    } while (member != region);
+                }
             }
+        }
+
+        //Decides the enclaveness of the regions reachable from the start
+        //regions. The SCCs of the region graph are handled bottom-up, so every
+        //region sees the finished reach of the regions after it. Within a
+        //cycle, a region reaches past the other members only through those
+        //that are enclave, which is decided for the whole SCC at once so the
+        //result is independent of the order the regions are found in
+        deque<RegionReach> regionReaches;
+        map<nDRFRegion*,const RegionReach*> reachOfRegion;
+
+        //What the members of an SCC reach by themselves, and which members
+        //each of them leads to
+        struct SCCReaches {
+            map<nDRFRegion*,RegionReach> local;
+            map<nDRFRegion*,vector<nDRFRegion*> > successors;
+        };
+
+        //What region reaches when only the members in passable hand on what
+        //they reach. A member that is not passed still counts as reached
+        RegionReach getMemberReach(nDRFRegion *region, const set<nDRFRegion*> &passable,
+                                   SCCReaches &sccReaches) {
+            RegionReach reach = sccReaches.local[region];
+            SmallPtrSet<nDRFRegion*,8> visited;
+            vector<nDRFRegion*> worklist(sccReaches.successors[region]);
+            while (!worklist.empty()) {
+                nDRFRegion *member = worklist.back();
+                worklist.pop_back();
+                if (passable.count(member) == 0 || !visited.insert(member).second)
+                    continue;
+                const RegionReach &memberReach = sccReaches.local[member];
+                reach.instructions = pathSets->unite(reach.instructions,memberReach.instructions);
+                reach.regions.insert(memberReach.regions.begin(),memberReach.regions.end());
+                vector<nDRFRegion*> &next = sccReaches.successors[member];
+                worklist.insert(worklist.end(),next.begin(),next.end());
+            }
+            return reach;
+        }
+
+        //Decides which members of a cycle are enclave. A member that conflicts
+        //when going past only the members known to be enclave never is, and a
+        //member that does not conflict when going past every member not known
+        //to conflict always is. Both only grow, so this ends, and members left
+        //undecided are not enclave. Probes only look for one conflict and
+        //record nothing
+        set<nDRFRegion*> decideSCCEnclaveness(vector<nDRFRegion*> &scc, SCCReaches &sccReaches) {
+            set<nDRFRegion*> enclave, notEnclave;
+            map<pair<nDRFRegion*,pair<const PathSet*,set<nDRFRegion*> > >,bool> probed;
+            auto conflicts = [&](nDRFRegion *region, const RegionReach &reach) {
+                auto key = make_pair(region,make_pair(&reach.instructions.get(),
+                                                      set<nDRFRegion*>(reach.regions.begin(),reach.regions.end())));
+                auto found = probed.find(key);
+                if (found != probed.end())
+                    return found->second;
+                return probed[key] = extendDRFRegion(region,reach,true);
+            };
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (nDRFRegion * region : scc) {
+                    if (isSignalRegion(region) || enclave.count(region) != 0 || notEnclave.count(region) != 0)
+                        continue;
+                    if (conflicts(region,getMemberReach(region,enclave,sccReaches))) {
+                        notEnclave.insert(region);
+                        changed = true;
+                        continue;
+                    }
+                    set<nDRFRegion*> mayPass;
+                    for (nDRFRegion * member : scc)
+                        if (!isSignalRegion(member) && notEnclave.count(member) == 0)
+                            mayPass.insert(member);
+                    if (!conflicts(region,getMemberReach(region,mayPass,sccReaches))) {
+                        enclave.insert(region);
+                        changed = true;
+                    }
+                }
+            }
+            VERBOSE_PRINT("Decided " << enclave.size() << " of " << scc.size() << " regions of a cycle to be enclave\n");
+            return enclave;
+        }
+        void extendDRFRegions() {
+            //Collect what is reachable from where the threads start
+            vector<nDRFRegion*> regions;
+            SmallPtrSet<nDRFRegion*,16> seen;
+            for (nDRFRegion * region : nDRFRegions)
+                if (region->startHere && seen.insert(region).second) {
+                    VERBOSE_PRINT("Starting from region: " << region->ID << "\n");
+                    regions.push_back(region);
+                }
+            for (unsigned i = 0; i < regions.size(); ++i) {
+                vector<nDRFRegion*> successors;
+                getSuccessorRegions(regions[i],successors);
+                for (nDRFRegion * successor : successors)
+                    if (seen.insert(successor).second)
+                        regions.push_back(successor);
+            }
+            sort(regions.begin(),regions.end(),
+                 [](nDRFRegion *a, nDRFRegion *b) {return a->ID < b->ID;});
+
+            vector<vector<nDRFRegion*> > sccs;
+            getRegionSCCs(regions,sccs);
+            VERBOSE_PRINT("Extending over " << regions.size() << " nDRF regions in " << sccs.size() << " SCCs\n");
+            //Signal regions and regions with conflicts hand nothing on
+            regionReaches.push_back(RegionReach());
+            const RegionReach *noReach = &regionReaches.back();
+            //Signal regions are known up front, the SCC order does not place
+            //them before the regions that lead to them
+            for (nDRFRegion * region : regions)
+                if (isSignalRegion(region))
+                    reachOfRegion[region] = noReach;
+            for (vector<nDRFRegion*> &scc : sccs) {
+                sort(scc.begin(),scc.end(),
+                     [](nDRFRegion *a, nDRFRegion *b) {return a->ID < b->ID;});
+                SmallPtrSet<nDRFRegion*,4> inSCC(scc.begin(),scc.end());
+                SCCReaches sccReaches;
+                set<nDRFRegion*> passable;
+                for (nDRFRegion * region : scc) {
+                    if (isSignalRegion(region))
+                        continue;
+                    passable.insert(region);
+                    RegionReach &reach = sccReaches.local[region];
+                    vector<nDRFRegion*> &successors = sccReaches.successors[region];
+                    //The instructions of the regions that follow us, and what
+                    //they reach themselves
+                    for (nDRFRegion * following : region->followingRegions) {
+                        reach.instructions = pathSets->unite(reach.instructions,region->followingInstructions[following]);
+                        reach.regions.insert(following);
+                        if (following && inSCC.count(following) != 0)
+                            successors.push_back(following);
+                        else if (following) {
+                            const RegionReach *followingReach = reachOfRegion[following];
+                            reach.instructions = pathSets->unite(reach.instructions,followingReach->instructions);
+                            reach.regions.insert(followingReach->regions.begin(),followingReach->regions.end());
+                        }
+                    }
+                    //What the regions that synch with us reach
+                    for (nDRFRegion * synch : region->synchsWith) {
+                        reach.regions.insert(synch);
+                        if (inSCC.count(synch) != 0)
+                            successors.push_back(synch);
+                        else {
+                            const RegionReach *synchReach = reachOfRegion[synch];
+                            reach.instructions = pathSets->unite(reach.instructions,synchReach->instructions);
+                            reach.regions.insert(synchReach->regions.begin(),synchReach->regions.end());
+                        }
+                    }
+                }
+                //A lone region reaches nothing more by going past itself, and
+                //resolved conflicts never keep a region from being enclave, so
+                //only cycles with unresolved conflicts need deciding
+                if (scc.size() > 1 && !conflictNDRF)
+                    passable = decideSCCEnclaveness(scc,sccReaches);
+                for (nDRFRegion * region : scc) {
+                    if (isSignalRegion(region)) {
+                        extendDRFRegion(region,*noReach);
+                        continue;
+                    }
+                    regionReaches.push_back(getMemberReach(region,passable,sccReaches));
+                    extendDRFRegion(region,regionReaches.back());
+                    //Undecided members are not enclave, whatever their final
+                    //reach shows, as the others do not go past them
+                    if (passable.count(region) == 0)
+                        region->enclave = false;
+                    reachOfRegion[region] = region->enclave ? &regionReaches.back() : noReach;
+                }
+            }
+        }
+
+        //Cross-checks over regionToExtend, given what it reaches. Returns true
+        //if a conflict keeps it from being enclave. A probe only looks for one
+        //such conflict, it records nothing and leaves the region as it is
+        bool extendDRFRegion(nDRFRegion *regionToExtend, const RegionReach &reach, bool probe=false) {
+            VERBOSE_PRINT("Handling region " << regionToExtend->ID << "\n");
+            const SharedPathSet &toCompareAgainst = reach.instructions;
+            const SmallPtrSet<nDRFRegion*,2> &followingRegions = reach.regions;
 
             //Handle special cases, signals and waits are never xDRF
-            if (regionToExtend->receivesSignal || regionToExtend->sendsSignal) {
-                regionToExtend->enclave=false;
-                // The returned sets must be cleared to prevent crosschecks by callers across the non-enclave nDRF.
-                toCompareAgainst.clear();
-                followingRegions.clear();
-                return extendDRFRegionDynamic[regionToExtend]=make_pair(toCompareAgainst,followingRegions);
+            if (isSignalRegion(regionToExtend)) {
+                if (!probe)
+                    regionToExtend->enclave=false;
+                return true;
             }
             
+            //Interned, as conflict candidates are looked up by set
+            SharedPathSet precedingInsts = pathSets->intern(regionToExtend->getPrecedingInsts());
             VERBOSE_PRINT("Handling " << regionToExtend->ID << ":\n");
-            VERBOSE_PRINT("  Has " << regionToExtend->getPrecedingInsts().size() << " preceding instructions\n"); 
+            VERBOSE_PRINT("  Has " << precedingInsts.size() << " preceding instructions\n"); 
             VERBOSE_PRINT("  Contains " << regionToExtend->containedInstructions.size() << " instructions\n");
             VERBOSE_PRINT("  Must compare against " << toCompareAgainst.size() << " following instructions\n");
             VERBOSE_PRINT("  And " << followingRegions.size() << " regions\n");
             bool conflict = false;
-            //Cross-check
-            for (Instruction * instPre : regionToExtend->getPrecedingInsts()) {    
-                for (Instruction * instAfter : toCompareAgainst) {
-                    //Comparing instructions to themselves, in case of loops, is perfectly fine
-                    if (MAYCONFLICT_DRF_DRF(instPre,instAfter)) {
-                        if (!conflictNDRF) {
-                            if (!skipConflictStore)
-                                regionToExtend->conflictsBetweenDRF.insert(make_pair(instPre,instAfter));
-                            DEBUG_PRINT("Found conflict between preceding and following DRF regions\n");
-                            conflict=true;
-                        } else {
-                            // CRA
-                            nDRFRegion *resolvedNDRFPre = getResolvedNDRF(instPre);
-                            nDRFRegion *resolvedNDRFAfter = getResolvedNDRF(instAfter);
-                            if (!skipConflictStore) {
-                                pair<Instruction*,Instruction*> conflpair = make_pair(instPre,instAfter);
-                                resolvedNDRFPre->resolvedBetweenDRF.insert(conflpair);
-                                resolvedNDRFAfter->resolvedBetweenDRF.insert(conflpair);
-                                regionToExtend->resolvedBetweenDRF.insert(conflpair);
-                            }
-                            DEBUG_PRINT("Found and resolved conflict between preceding and following DRF regions\n");
-                            //conflict=false; // Suppress setting conflict
-                        }
-                    }
-                }
+            //Segments whose summaries show they cannot conflict are not
+            //checked instruction by instruction
+            SharedPathSet followingForPreceding = segmentsMayConflict(precedingInsts,toCompareAgainst,false) ?
+                toCompareAgainst : SharedPathSet();
+            SharedPathSet precedingForContained = segmentsMayConflict(precedingInsts,regionToExtend->containedInstructions,useSpecializedCrossCheck) ?
+                precedingInsts : SharedPathSet();
+            SharedPathSet followingForContained = segmentsMayConflict(regionToExtend->containedInstructions,toCompareAgainst,useSpecializedCrossCheck) ?
+                toCompareAgainst : SharedPathSet();
+            SmallPtrSet<nDRFRegion*,2> followingToCheck;
+            for (nDRFRegion * region : followingRegions)
+                if (region && segmentsMayConflict(precedingInsts,region->containedInstructions,useSpecializedCrossCheck))
+                    followingToCheck.insert(region);
+            //When the conflicting pairs are neither stored nor resolved, one
+            //witness decides the region
+            bool witnessOnly = probe || (skipConflictStore && !conflictNDRF);
+            //Cross-check. The checks are listed in the order they are made
+            //serially, and what they find is recorded in that order
+            vector<CrossCheck> checks;
+            for (Instruction * instPre : precedingInsts) {    
+                checks.push_back(CrossCheck(CrossCheck::PrecedingFollowing,instPre,NULL,followingForPreceding));
                 //Check our preceding instructions towards the instructions inside the following nDRFs
-                for (nDRFRegion * region : followingRegions) {
-                    if (region) {
-                        for (Instruction * instIn : region->containedInstructions) {
-                            if (MAYCONFLICT_DRF_NDRF(instPre,instIn)) {
-                                if (!conflictNDRF) {
-                                    if (!skipConflictStore)
-                                        regionToExtend->conflictsTowardsDRF.insert(make_pair(instPre,make_pair(region,instIn)));
-                                    DEBUG_PRINT("Found conflict between preceding DRF and following nDRF regions\n");
-                                    conflict=true;
-                                } else {
-                                    // CRA
-                                    nDRFRegion *resolvedNDRFPre = getResolvedNDRF(instPre);
-                                    if (!skipConflictStore) {
-                                        pair<Instruction*,pair<nDRFRegion*,Instruction*> > conflpair = make_pair(instPre,make_pair(region,instIn));
-                                        resolvedNDRFPre->resolvedTowardsDRF.insert(conflpair);
-                                        regionToExtend->resolvedTowardsDRF.insert(conflpair);
-                                    }
-                                    DEBUG_PRINT("Found and resolved conflict between preceding DRF and following nDRF regions\n");
-                                    //conflict=false; // Suppress setting conflict
-                                }
-                            }
-                        }
-                    }
-                }
+                for (nDRFRegion * region : followingRegions)
+                    if (followingToCheck.count(region) != 0)
+                        checks.push_back(CrossCheck(CrossCheck::PrecedingFollowingNDRF,instPre,region,region->containedInstructions));
             }
             //Check the instructions within our nDRF towards all previous and following insts
             for (Instruction * instIn : regionToExtend->containedInstructions) {
-                for (Instruction * instPre : regionToExtend->getPrecedingInsts()) {   
-                    if (MAYCONFLICT_DRF_NDRF(instPre,instIn)) {
-                        if (!conflictNDRF) {
-                            if (!skipConflictStore)
-                                regionToExtend->conflictsTowardsDRF.insert(make_pair(instPre,make_pair(regionToExtend,instIn)));
-                            DEBUG_PRINT("Found conflict between nDRF region and preceding DRF regions\n");
-                            conflict=true;
-                        } else {
-                            // CRA
-                            nDRFRegion *resolvedNDRFPre = getResolvedNDRF(instPre);
-                            if (!skipConflictStore) {
-                                pair<Instruction*,pair<nDRFRegion*,Instruction*> > conflpair = make_pair(instPre,make_pair(regionToExtend,instIn));
-                                resolvedNDRFPre->resolvedTowardsDRF.insert(conflpair);
-                                regionToExtend->resolvedTowardsDRF.insert(conflpair);
-                            }
-                            DEBUG_PRINT("Found and resolved conflict between nDRF region and preceding DRF regions\n");
-                            //conflict=false; // Suppress setting conflict
-                        }
-                    }
-                }
-                for (Instruction * instAfter : toCompareAgainst) {   
-                    if (MAYCONFLICT_DRF_NDRF(instIn,instAfter)) {
-                        if (!conflictNDRF) {
-                            if (!skipConflictStore)
-                                regionToExtend->conflictsTowardsDRF.insert(make_pair(instAfter,make_pair(regionToExtend,instIn)));
-                            DEBUG_PRINT("Found conflict between nDRF region and following DRF regions\n");
-                            conflict=true;
-                        } else {
-                            // CRA
-                            nDRFRegion *resolvedNDRFAfter = getResolvedNDRF(instAfter);
-                            if (!skipConflictStore) {
-                                pair<Instruction*,pair<nDRFRegion*,Instruction*> > conflpair = make_pair(instAfter,make_pair(regionToExtend,instIn));
-                                resolvedNDRFAfter->resolvedTowardsDRF.insert(conflpair);
-                                regionToExtend->resolvedTowardsDRF.insert(conflpair);
-                            }
-                            DEBUG_PRINT("Found and resolved conflict between nDRF region and following DRF regions\n");
-                            //conflict=false; // Suppress setting conflict
-                        }
-                    }
-                }
+                checks.push_back(CrossCheck(CrossCheck::ContainedPreceding,instIn,regionToExtend,precedingForContained));
+                checks.push_back(CrossCheck(CrossCheck::ContainedFollowing,instIn,regionToExtend,followingForContained));
             }
-
-            //If no conflicts are detected by extending over us, make us enclave
-            if (!conflict) {
-                regionToExtend->enclave=true;
-            } else {
-                regionToExtend->enclave=false;
-                //Otherwise, the things that follow us are not of interest to our parent
-                toCompareAgainst.clear();
-                followingRegions.clear();
+            vector<vector<Instruction*> > conflicting = runCrossChecks(checks,witnessOnly);
+            if (probe) {
+                //Only unresolved conflicts keep a region from being enclave
+                for (unsigned i = 0; i < checks.size(); ++i)
+                    if (!conflicting[i].empty() && !conflictNDRF)
+                        return true;
+                return false;
             }
+            for (unsigned i = 0; i < checks.size(); ++i)
+                for (Instruction *other : conflicting[i])
+                    if (recordConflict(regionToExtend,checks[i],other)) {
+                        conflictWitnesses.insert(checks[i].inst);
+                        conflictWitnesses.insert(other);
+                        conflict = true;
+                    }
 
-            return extendDRFRegionDynamic[regionToExtend]=make_pair(toCompareAgainst,followingRegions);
+            //If no conflicts are detected by extending over us, make us enclave.
+            //Otherwise, the things that follow us are not of interest to the
+            //regions before us
+            regionToExtend->enclave=!conflict;
+            return conflict;
         }
         
         void printInfo() {
@@ -985,8 +1392,8 @@ namespace {
                 for (Instruction * inst : region->endsAt) {
                     VERBOSE_PRINT("   " << *inst << "\n");
                 }
-                SmallPtrSet<Instruction*,128> precedingInsts = region->getPrecedingInsts();
-                SmallPtrSet<Instruction*,128> followingInsts = region->getFollowingInsts();
+                PathSet precedingInsts = region->getPrecedingInsts();
+                PathSet followingInsts = region->getFollowingInsts();
                 VERBOSE_PRINT("  Preceded by " << precedingInsts.size() << " instructions\n");
                 VERBOSE_PRINT("  Contains " << region->containedInstructions.size() << " instructions\n");
                 VERBOSE_PRINT("  Followed by " << followingInsts.size() << " instructions\n");
@@ -1056,9 +1463,8 @@ namespace {
             }
             VERBOSE_PRINT("Continuing xDRF region " << inRegion->ID << " towards nDRF region " << startHere->ID << "\n");
             //We will always add the following nDRFs preceding instructions to us
-            SmallPtrSet<Instruction*,128> predinsts = startHere->getPrecedingInsts();
-            inRegion->containedInstructions.insert(predinsts.begin(),
-                                                   predinsts.end());
+            inRegion->containedInstructions = pathSets->unite(inRegion->containedInstructions,
+                                                              startHere->getPrecedingInsts());
             for (auto region : xDRFRegions) {
                 DEBUG_PRINT("Region contains:\n");
                 DEBUG_PRINT("Following:\n");
@@ -1123,9 +1529,8 @@ namespace {
                     consolidateXDRFRegions(followRegion,inRegion);
                 else {
                     //Followed by context end, just add the following insts
-                    SmallPtrSet<Instruction*,128> followinsts = startHere->getFollowingInsts();
-                    inRegion->containedInstructions.insert(followinsts.begin(),
-                                                           followinsts.end());
+                    inRegion->containedInstructions = pathSets->unite(inRegion->containedInstructions,
+                                                                      startHere->getFollowingInsts());
                 }
             }
 
@@ -1163,22 +1568,64 @@ namespace {
             }
         }
         
+        //Fills in the instruction to region index and numbers the groups of
+        //related xDRFs, once the regions are final
+        void buildRegionIndex() {
+            vector<xDRFRegion*> xdrfs(xDRFRegions.begin(),xDRFRegions.end());
+            sort(xdrfs.begin(),xdrfs.end(),
+                 [](xDRFRegion *a, xDRFRegion *b) {return a->ID < b->ID;});
+            vector<nDRFRegion*> ndrfs(nDRFRegions.begin(),nDRFRegions.end());
+            sort(ndrfs.begin(),ndrfs.end(),
+                 [](nDRFRegion *a, nDRFRegion *b) {return a->ID < b->ID;});
+            xDRFRegionOfID.assign(instNumbering->size(),NULL);
+            nDRFRegionOfID.assign(instNumbering->size(),NULL);
+            for (xDRFRegion * region : xdrfs)
+                for (Instruction * inst : region->containedInstructions) {
+                    unsigned ID = instNumbering->getID(inst);
+                    if (!xDRFRegionOfID[ID])
+                        xDRFRegionOfID[ID] = region;
+                }
+            for (nDRFRegion * region : ndrfs)
+                for (Instruction * inst : region->containedInstructions) {
+                    unsigned ID = instNumbering->getID(inst);
+                    if (!nDRFRegionOfID[ID])
+                        nDRFRegionOfID[ID] = region;
+                }
+            //Related xDRFs are grouped transitively
+            int relatedID = 0;
+            for (xDRFRegion * region : xdrfs) {
+                if (region->relatedID != -1)
+                    continue;
+                vector<xDRFRegion*> toVisit(1,region);
+                region->relatedID = relatedID;
+                while (!toVisit.empty()) {
+                    xDRFRegion *visit = toVisit.back();
+                    toVisit.pop_back();
+                    for (xDRFRegion * related : visit->relatedXDRFs)
+                        if (related->relatedID == -1) {
+                            related->relatedID = relatedID;
+                            toVisit.push_back(related);
+                        }
+                }
+                ++relatedID;
+            }
+            VERBOSE_PRINT("Indexed " << xdrfs.size() << " xDRF regions in " << relatedID << " related groups\n");
+        }
+
         //Some convenience functions to make interfacing easier:
 
         //Obtain the XDRF region of an instruction, or NULL if it is in an nDRF region
         xDRFRegion* getXDRFRegionOfInstruction(Instruction *inst) {
-            for (xDRFRegion * region: xDRFRegions)
-                if (region->containedInstructions.count(inst) != 0)
-                    return region;
-            return NULL;
+            if (!instNumbering->hasID(inst))
+                return NULL;
+            return xDRFRegionOfID[instNumbering->getID(inst)];
         }
 
         //Obtain the nDRF region of an instruction, or NULL if it is in an xDRF region
         nDRFRegion* getNDRFRegionOfInstruction(Instruction *inst) {
-            for (nDRFRegion * region: nDRFRegions)
-                if (region->containedInstructions.count(inst) != 0)
-                    return region;
-            return NULL;
+            if (!instNumbering->hasID(inst))
+                return NULL;
+            return nDRFRegionOfID[instNumbering->getID(inst)];
         }
         
         //Check whether two instructions are within the same xDRF region
@@ -1187,6 +1634,13 @@ namespace {
                 *reg2 = getXDRFRegionOfInstruction(inst2);
             return reg1 != NULL && reg1 == reg2;
         }
+
+        //Check whether two instructions are within the same or related xDRF regions
+        bool areInRelatedXDRFRegions(Instruction *inst1, Instruction *inst2) {
+            xDRFRegion *reg1 = getXDRFRegionOfInstruction(inst1),
+                *reg2 = getXDRFRegionOfInstruction(inst2);
+            return reg1 != NULL && reg2 != NULL && reg1->relatedID == reg2->relatedID;
+        }
     };
 }
 
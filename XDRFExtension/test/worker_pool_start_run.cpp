@@ -0,0 +1,42 @@
+//===-- WorkerPool: a job posted right after start() reaches every worker -===//
+//
+// runCrossChecks starts the pool and runs the first job with nothing in
+// between. Workers that only read the generation once they got to run then
+// waited for a later job, and run() never returned. Each iteration uses a
+// fresh pool, so every first run races the threads it just started.
+//
+// g++ -std=c++11 -pthread -I.. worker_pool_start_run.cpp -o worker_pool_start_run
+// ./worker_pool_start_run
+//
+// Expected output, within a few seconds:
+//   ok
+//===----------------------------------------------------------------------===//
+
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+
+#include "WorkerPool.hpp"
+
+int main() {
+    const unsigned threads = 4;
+    for (unsigned iteration = 0; iteration < 2000; ++iteration) {
+        WorkerPool pool;
+        atomic<unsigned> ran(0);
+        pool.start(threads);
+        pool.run([&]() {ran++;});
+        if (ran != threads) {
+            cout << "first run reached " << ran << " of " << threads << " workers\n";
+            return EXIT_FAILURE;
+        }
+        //Later jobs, and workers added between them, see every job once
+        pool.start(threads+1);
+        pool.run([&]() {ran++;});
+        if (ran != 2*threads+1) {
+            cout << "second run reached " << ran-threads << " of " << threads+1 << " workers\n";
+            return EXIT_FAILURE;
+        }
+    }
+    cout << "ok\n";
+    return EXIT_SUCCESS;
+}
@@ -53,6 +53,15 @@ if [ $? -ne 0 ]; then
     exit 1
 fi
 
+# The synchronization point graph does not depend on the aliasing options,
+# so the runs below share it through this file
+SPDCACHE=$(mktemp -t xDRF-internal.XXXXXXXXXX)
+if [ $? -ne 0 ]; then
+    rm -f "$TMPLL"
+    echo "Failed to make temporary cache file."
+    exit 1
+fi
+
 CALL_OPT() {
     # This function will perform a call to "$OPT -S" with the given
     # parameters to the function. It will use $TMPLL as input,
@@ -61,7 +70,7 @@ CALL_OPT() {
 
     local TMPOUT=$(mktemp -t xDRF-internal.XXXXXXXXXX)
     if [ $? -ne 0 ]; then
-        rm -f "$TMPLL"
+        rm -f "$TMPLL" "$SPDCACHE"
         echo "Failed to make temporary output file."
         exit 1
     fi
@@ -75,7 +84,7 @@ CALL_OPT() {
 
 CALL_OPT_XDRF() {
     # Convenience for loading relevant passes
-    CALL_OPT -load "$FlowSensitiveSo" -load "$MarkXDRFRegionsSo" "$@"
+    CALL_OPT -load "$FlowSensitiveSo" -load "$MarkXDRFRegionsSo" -spdcache "$SPDCACHE" "$@"
 }
 
 # Copy to temporary file
@@ -117,6 +126,6 @@ if [ -n "$outputFile" ] ; then
 else
     cat "$TMPLL"
 fi
-rm -f "$TMPLL"
+rm -f "$TMPLL" "$SPDCACHE"
 
 echo "Stop marking procedure: $(GET_DATE)"